@@ -0,0 +1,25 @@
+#!/bin/sh
+# ARQ strategies side by side: goodput (bytes delivered per simulated second)
+# and retransmission overhead (retransmissions per packet sent) of
+# stop-and-wait, go-back-N and selective repeat across loss and reorder rates.
+#   usage: bench_arq.sh [rdt_sim binary]
+
+SIM=${1:-./rdt_sim_opt}
+
+printf "%-5s %-6s %-8s %12s %10s %9s\n" arq loss reorder goodput overhead verified
+for loss in 0 0.05 0.15; do
+    for reorder in 0 0.15; do
+	for arq in saw gbn sr; do
+	    $SIM --arq=$arq --batch --seed=11 1000 0.1 100 $reorder $loss 0 0 | awk -v arq=$arq -v loss=$loss -v reorder=$reorder -F= '
+		/^sim\.time=/              { time = $2 }
+		/^sim\.chars_delivered=/   { delivered = $2 }
+		/^sim\.verified=/          { ok = $2 }
+		/^sender\.first_sent=/     { sent = $2 }
+		/^sender\.timeout_resent=/ { resent += $2 }
+		/^sender\.fast_resent=/    { resent += $2 }
+		END { goodput = time > 0 ? delivered / time : 0
+		      overhead = sent > 0 ? resent / sent : 0
+		      printf "%-5s %-6s %-8s %12.0f %10.3f %9s\n", arq, loss, reorder, goodput, overhead, ok ? "yes" : "NO" }'
+	done
+    done
+done
@@ -0,0 +1,22 @@
+#!/bin/sh
+# Packet size sweep: the optimized simulator built for each packet size runs
+# the same backlogged transfer at a fixed loss rate.  Reports how fast the
+# simulator goes (events and bytes per wall second) and the goodput of the
+# protocol (bytes delivered per simulated second).
+#   usage: bench_pktsize.sh [sizes]
+
+SIZES=${1:-"64 128 256 512 1500 4096 9000"}
+
+printf "%-7s %10s %12s %14s %12s %9s\n" pktsize events events/sec bytes/sec goodput verified
+for size in $SIZES; do
+    make -s rdt_sim_pkt$size >/dev/null 2>&1 || { echo "cannot build rdt_sim_pkt$size"; exit 1; }
+    ./rdt_sim_pkt$size --batch --seed=7 100 0.1 20000 0 0.05 0 0 | awk -v size=$size -F= '
+	/^sim\.time=/            { time = $2 }
+	/^sim\.chars_delivered=/ { delivered = $2 }
+	/^sim\.events=/          { events = $2 }
+	/^sim\.events_per_sec=/  { eps = $2 }
+	/^sim\.bytes_per_sec=/   { bps = $2 }
+	/^sim\.verified=/        { ok = $2 }
+	END { goodput = time > 0 ? delivered / time : 0
+	      printf "%-7s %10d %12d %14d %12.0f %9s\n", size, events, eps, bps, goodput, ok ? "yes" : "NO" }'
+done
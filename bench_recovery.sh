@@ -0,0 +1,30 @@
+#!/bin/sh
+# Loss recovery: how long a lost packet takes from its first transmission to
+# its ack, with the sender's timeouts alone and with the receiver's NAKs.
+# Reordering is swept too, a reordered packet must not pass for a lost one;
+# much more of it than 5% makes stale copies wrap the 11 seqs, NAKs or not.
+# Exits with 1 if any run does not deliver the data intact.
+#   usage: bench_recovery.sh [rdt_sim binary]
+
+SIM=${1:-./rdt_sim_opt}
+
+failed=0
+printf "%-6s %-6s %-8s %10s %10s %10s %14s %9s\n" ooo loss mode timeouts nak_resent recovered mean_recovery verified
+for ooo in 0.0 0.02 0.05; do
+    for loss in 0.02 0.05 0.1 0.2; do
+	for mode in timeout nak; do
+	    opts=""
+	    [ $mode = nak ] && opts="--nak"
+	    $SIM $opts --batch --seed=7 2000 0.1 100 $ooo $loss 0.05 0 | awk -v ooo=$ooo -v loss=$loss -v mode=$mode -F= '
+		/^sender\.timeout_resent=/ { timeouts = $2 }
+		/^sender\.fast_resent=/    { fast = $2 }
+		/^sender\.recovered=/      { recovered = $2 }
+		/^sender\.mean_recovery=/  { mean = $2 }
+		/^sim\.verified=/          { ok = $2 }
+		END { printf "%-6s %-6s %-8s %10d %10d %10d %14.4f %9s\n", ooo, loss, mode, timeouts, fast, recovered, mean, ok ? "yes" : "NO"
+		      exit ok ? 0 : 1 }' || failed=1
+	done
+    done
+done
+[ $failed = 0 ] || echo "some runs did not verify"
+exit $failed
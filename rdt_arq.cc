@@ -0,0 +1,148 @@
+/*
+ * FILE: rdt_arq.cc
+ * DESCRIPTION: The sender and receiver entry points, forwarded to the ARQ
+ *              strategy of rdt_config.arq.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include "rdt_struct.h"
+#include "rdt_sender.h"
+#include "rdt_receiver.h"
+#include "rdt_util.h"
+#include "rdt_arq.h"
+#include "rdt_checkpoint.h"
+
+GoBackNArq gbn_arq;
+StopAndWaitArq saw_arq;
+
+static const char *arq_names[] = {"sr", "gbn", "saw"};
+
+int parse_arq(const char *name)
+{
+    for (int i = 0; i < (int) (sizeof(arq_names) / sizeof(arq_names[0])); ++i)
+        if (strcmp(name, arq_names[i]) == 0) return i;
+    return -1;
+}
+
+const char *arq_name(int arq)
+{
+    return arq_names[arq];
+}
+
+void Sender_Init()
+{
+    fprintf(stdout, "At %.2fs: sender initializing ...\n", GetSimulationTime());
+    switch (rdt_config.arq) {
+    case ARQ_GBN: gbn_arq.sender_init(); break;
+    case ARQ_SAW: saw_arq.sender_init(); break;
+    default: sr_sender_init();
+    }
+}
+
+void Sender_FromUpperLayer(struct message *msg)
+{
+    switch (rdt_config.arq) {
+    case ARQ_GBN: gbn_arq.sender_from_upper(msg); break;
+    case ARQ_SAW: saw_arq.sender_from_upper(msg); break;
+    default: sr_sender_from_upper(msg);
+    }
+}
+
+/* go-back-N and stop-and-wait have no streams, their messages all go to
+   stream 0 */
+void Sender_FromUpperLayerOnStream(struct message *msg, int stream)
+{
+    switch (rdt_config.arq) {
+    case ARQ_GBN: gbn_arq.sender_from_upper(msg); break;
+    case ARQ_SAW: saw_arq.sender_from_upper(msg); break;
+    default: sr_sender_from_upper_stream(msg, stream);
+    }
+}
+
+void Sender_FromLowerLayer(struct packet *pkt)
+{
+    switch (rdt_config.arq) {
+    case ARQ_GBN: gbn_arq.sender_from_lower(pkt); break;
+    case ARQ_SAW: saw_arq.sender_from_lower(pkt); break;
+    default: sr_sender_from_lower(pkt);
+    }
+}
+
+void Sender_FromLowerLayerBatch(struct packet **pkts, int n)
+{
+    switch (rdt_config.arq) {
+    case ARQ_GBN: gbn_arq.sender_from_lower_batch(pkts, n); break;
+    case ARQ_SAW: saw_arq.sender_from_lower_batch(pkts, n); break;
+    default: sr_sender_from_lower_batch(pkts, n);
+    }
+}
+
+void Sender_Timeout()
+{
+    switch (rdt_config.arq) {
+    case ARQ_GBN: gbn_arq.sender_timeout(); break;
+    case ARQ_SAW: saw_arq.sender_timeout(); break;
+    default: sr_sender_timeout();
+    }
+}
+
+/* a checkpoint is restored with the strategy it was taken with */
+void Sender_Checkpoint(Checkpoint &ck)
+{
+    ck.expect(rdt_config.arq);
+    ck.value(sender_stats);
+    switch (rdt_config.arq) {
+    case ARQ_GBN: gbn_arq.sender_checkpoint(ck); break;
+    case ARQ_SAW: saw_arq.sender_checkpoint(ck); break;
+    default: sr_sender_checkpoint(ck);
+    }
+}
+
+void Receiver_Init()
+{
+    fprintf(stdout, "At %.2fs: receiver initializing ...\n", GetSimulationTime());
+    switch (rdt_config.arq) {
+    case ARQ_GBN: gbn_arq.receiver_init(); break;
+    case ARQ_SAW: saw_arq.receiver_init(); break;
+    default: sr_receiver_init();
+    }
+}
+
+void Receiver_FromLowerLayer(struct packet *pkt)
+{
+    switch (rdt_config.arq) {
+    case ARQ_GBN: gbn_arq.receiver_from_lower(pkt); break;
+    case ARQ_SAW: saw_arq.receiver_from_lower(pkt); break;
+    default: sr_receiver_from_lower(pkt);
+    }
+}
+
+void Receiver_FromLowerLayerBatch(struct packet **pkts, int n)
+{
+    switch (rdt_config.arq) {
+    case ARQ_GBN: gbn_arq.receiver_from_lower_batch(pkts, n); break;
+    case ARQ_SAW: saw_arq.receiver_from_lower_batch(pkts, n); break;
+    default: sr_receiver_from_lower_batch(pkts, n);
+    }
+}
+
+void Receiver_UpperLayerReady()
+{
+    switch (rdt_config.arq) {
+    case ARQ_GBN: gbn_arq.receiver_upper_ready(); break;
+    case ARQ_SAW: saw_arq.receiver_upper_ready(); break;
+    default: sr_receiver_upper_ready();
+    }
+}
+
+void Receiver_Checkpoint(Checkpoint &ck)
+{
+    ck.value(receiver_stats);
+    switch (rdt_config.arq) {
+    case ARQ_GBN: gbn_arq.receiver_checkpoint(ck); break;
+    case ARQ_SAW: saw_arq.receiver_checkpoint(ck); break;
+    default: sr_receiver_checkpoint(ck);
+    }
+}
@@ -0,0 +1,95 @@
+//
+// ARQ strategies behind the Sender_* and Receiver_* entry points.
+//
+// rdt_arq.cc picks the strategy of rdt_config.arq with a switch and calls
+// it directly, so the handlers of an event are never reached through a
+// virtual call.  Selective repeat lives in rdt_sender.cc/rdt_receiver.cc,
+// go-back-N and stop-and-wait are the GoBackN policy template instantiated
+// with their window sizes.
+//
+
+#ifndef RDT_RDT_ARQ_H
+#define RDT_RDT_ARQ_H
+
+#include <queue>
+#include <deque>
+#include "rdt_struct.h"
+#include "rdt_util.h"
+
+class Checkpoint;
+
+enum {
+    ARQ_SR,     // selective repeat, the default
+    ARQ_GBN,    // go-back-N
+    ARQ_SAW,    // stop-and-wait
+};
+
+/* parse "sr", "gbn" or "saw", -1 if it is none of them */
+int parse_arq(const char *name);
+
+const char *arq_name(int arq);
+
+/* selective repeat */
+void sr_sender_init();
+void sr_sender_from_upper(struct message *msg);
+void sr_sender_from_upper_stream(struct message *msg, int stream);
+void sr_sender_from_lower(struct packet *pkt);
+void sr_sender_from_lower_batch(struct packet **pkts, int n);
+void sr_sender_timeout();
+void sr_sender_checkpoint(Checkpoint &ck);
+void sr_receiver_init();
+void sr_receiver_from_lower(struct packet *pkt);
+void sr_receiver_from_lower_batch(struct packet **pkts, int n);
+void sr_receiver_upper_ready();
+void sr_receiver_checkpoint(Checkpoint &ck);
+
+#define GBN_ACK_SIZE (ACK_SIZE + 1)     // a go-back-N ack also carries the low byte of a count
+
+/* go-back-N with a window of N packets: one clock for the oldest packet in
+   flight, cumulative acks, and a timeout resends the whole window.  the
+   receiver takes packets in order only.  stop-and-wait is N = 1.
+   messages are packetized raw, NAKs, compression, streams and the
+   advertised window are selective repeat only */
+template <int N>
+class GoBackN
+{
+    std::queue<packet> packets;     // waiting for the window
+    packet window[N];               // in flight, window[0] is seq base
+    double send_time[N];
+    bool resent[N];
+    int base, next_seq, outstanding;
+    bool stalled;                   // packets are waiting on a full window
+    long long acked_count;          // packets acked from the start
+    std::deque<packet> ready;       // in order, waiting for the upper layer
+    int expected;
+    long long taken;                // packets taken in order from the start
+
+    void try_send();
+    void slide(int acked);
+    void handle_ack(struct packet *pkt);
+    void deliver_ready();
+    void send_ack();
+    bool take(struct packet *pkt);
+
+public:
+    void sender_init();
+    void sender_from_upper(struct message *msg);
+    void sender_from_lower(struct packet *pkt);
+    void sender_from_lower_batch(struct packet **pkts, int n);
+    void sender_timeout();
+    void sender_checkpoint(Checkpoint &ck);
+    void receiver_init();
+    void receiver_from_lower(struct packet *pkt);
+    void receiver_from_lower_batch(struct packet **pkts, int n);
+    void receiver_upper_ready();
+    void receiver_checkpoint(Checkpoint &ck);
+};
+
+// N must leave old acks distinguishable from new ones in the sequence space
+typedef GoBackN<MAX_WINDOW> GoBackNArq;
+typedef GoBackN<1> StopAndWaitArq;
+
+extern GoBackNArq gbn_arq;
+extern StopAndWaitArq saw_arq;
+
+#endif //RDT_RDT_ARQ_H
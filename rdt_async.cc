@@ -0,0 +1,138 @@
+/*
+ * FILE: rdt_async.cc
+ * DESCRIPTION: Coroutine interface of the upper layers.  Only the sender
+ *              side passes messages down: a send of a coroutine resumed by a
+ *              delivery waits for the next event at the sender, an ack or
+ *              the poll of the upper layer.
+ */
+
+
+#include <stdio.h>
+
+#include "rdt_struct.h"
+#include "rdt_sender.h"
+#include "rdt_util.h"
+#include "rdt_header.h"
+#include "rdt_simcore.h"
+#include "rdt_async.h"
+
+/* how often the upper layer at the sender looks at the send queue when no
+   ack comes in (in seconds), as in rdt_xfer */
+#define ASYNC_POLL_SIMULATED 0.1
+#define ASYNC_POLL_REALTIME 0.0005
+
+
+/* the packets the sender cuts a message into, the raw ones: a compressed
+   packet carries more of it than a raw one */
+static int packets_of(int size, int stream)
+{
+    Header h;
+    h.flags = stream!=0 ? FLAG_STREAM : 0;
+    h.seq = 0;
+    h.size = 0;
+    h.stream = stream;
+    h.stream_seq = 0;
+    int n = 0;
+    for (int left = size; left>0; left -= payload_room(&h, left))
+	n++;
+    return n;
+}
+
+Connection::Connection(int queue_limit_)
+    : queue_limit(queue_limit_), inboxes(MAX_STREAMS), receivers(MAX_STREAMS)
+{
+}
+
+Connection::~Connection()
+{
+    for (size_t i=0; i<tasks.size(); i++)
+	tasks[i].destroy();
+}
+
+void Connection::spawn(Task task)
+{
+    tasks.push_back(task.handle);
+    starting.push_back(task.handle);
+}
+
+int Connection::unfinished()
+{
+    int n = 0;
+    for (size_t i=0; i<tasks.size(); i++)
+	if (!tasks[i].done()) n++;
+    return n;
+}
+
+/* resume the sends that are acked, start the new coroutines, and pass the
+   waiting messages down while the send queue has room for all of their
+   packets, until none of them is left to do.  a message longer than the
+   limit goes down alone into an empty queue */
+void Connection::step()
+{
+    for (bool progress = true; progress; ) {
+	progress = false;
+
+	while (!unacked.empty() && sender_stats.acked>=unacked.front().mark) {
+	    std::coroutine_handle<> h = unacked.front().waiter;
+	    unacked.pop_front();
+	    h.resume();
+	    progress = true;
+	}
+
+	while (!starting.empty()) {
+	    std::coroutine_handle<> h = starting.front();
+	    starting.pop_front();
+	    h.resume();
+	    progress = true;
+	}
+
+	while (!pending.empty()) {
+	    SendOp op = pending.front();
+	    if (sender_stats.queue_depth>0 &&
+		sender_stats.queue_depth + packets_of(op.size, op.stream)>queue_limit)
+		break;
+	    pending.pop_front();
+
+	    struct message msg;
+	    msg.size = op.size;
+	    msg.data = (char*) op.data;
+	    if (op.stream!=0)
+		Sender_FromUpperLayerOnStream(&msg, op.stream);
+	    else
+		Sender_FromUpperLayer(&msg);
+	    op.mark = sender_stats.queued;
+	    unacked.push_back(op);
+	    progress = true;
+	}
+    }
+}
+
+double Connection::first_arrival()
+{
+    return starting.empty() ? -1 : 0;
+}
+
+/* the upper layer at the sender polls until every message passed down is
+   acked.  a delivery happens before the ack of its packet is back, so no
+   coroutine resumed by one sends after the last poll */
+double Connection::send_next()
+{
+    step();
+    if (pending.empty() && unacked.empty()) return -1;
+    return realtime_mode ? ASYNC_POLL_REALTIME : ASYNC_POLL_SIMULATED;
+}
+
+void Connection::sender_progress()
+{
+    step();
+}
+
+void Connection::deliver(struct message *msg, int stream)
+{
+    inboxes[stream].push_back(std::string(msg->data, msg->size));
+    if (!receivers[stream].empty()) {
+	std::coroutine_handle<> h = receivers[stream].front();
+	receivers[stream].pop_front();
+	h.resume();
+    }
+}
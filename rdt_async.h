@@ -0,0 +1,129 @@
+/*
+ * FILE: rdt_async.h
+ * DESCRIPTION: Coroutine interface of the upper layers (C++20).  A program
+ *              spawns its coroutines on a Connection and runs it with
+ *              sim_run().  co_await conn.send(...) passes a message down
+ *              once the send queue has room and resumes when the message is
+ *              acked; co_await conn.recv() resumes with the next message
+ *              the rdt layer delivers.  The coroutines run in the events of
+ *              the simulation, in simulated time or in real time over the
+ *              loopback interface, but not in a parallel run.
+ */
+
+
+#ifndef _RDT_ASYNC_H_
+#define _RDT_ASYNC_H_
+
+#include <coroutine>
+#include <deque>
+#include <string>
+#include <vector>
+#include <exception>
+
+#include "rdt_simcore.h"
+
+/* a coroutine of the upper layers, it starts when the run does */
+class Task
+{
+public:
+    struct promise_type {
+	Task get_return_object() {
+	    return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+	}
+	std::suspend_always initial_suspend() noexcept { return {}; }
+	std::suspend_always final_suspend() noexcept { return {}; }
+	void return_void() {}
+	void unhandled_exception() { std::terminate(); }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+
+public:
+    explicit Task(std::coroutine_handle<promise_type> h) : handle(h) {}
+};
+
+/* the upper layers at both ends, driven by the events of the run */
+class Connection : public Application
+{
+private:
+    /* a message waiting for room in the send queue, then for its ack */
+    struct SendOp {
+	const char *data;
+	int size, stream;
+	long long mark;             /* acked once sender_stats.acked reaches it */
+	std::coroutine_handle<> waiter;
+    };
+
+public:
+    class SendAwaiter {
+    private:
+	Connection *conn;
+	SendOp op;
+    public:
+	SendAwaiter(Connection *conn_, const SendOp &op_) : conn(conn_), op(op_) {}
+	bool await_ready() { return false; }
+	void await_suspend(std::coroutine_handle<> h) {
+	    op.waiter = h;
+	    conn->pending.push_back(op);
+	}
+	void await_resume() {}
+    };
+
+    class RecvAwaiter {
+    private:
+	Connection *conn;
+	int stream;
+    public:
+	RecvAwaiter(Connection *conn_, int stream_) : conn(conn_), stream(stream_) {}
+	bool await_ready() { return !conn->inboxes[stream].empty(); }
+	void await_suspend(std::coroutine_handle<> h) { conn->receivers[stream].push_back(h); }
+	std::string await_resume() {
+	    std::string msg = conn->inboxes[stream].front();
+	    conn->inboxes[stream].pop_front();
+	    return msg;
+	}
+    };
+
+private:
+    int queue_limit;                /* packets in the send queue */
+    std::vector<std::coroutine_handle<> > tasks;
+    std::deque<std::coroutine_handle<> > starting;
+    std::deque<SendOp> pending;     /* waiting for room in the send queue */
+    std::deque<SendOp> unacked;     /* passed down, in queue order */
+    std::vector<std::deque<std::string> > inboxes;
+    std::vector<std::deque<std::coroutine_handle<> > > receivers;
+
+    void step();
+
+public:
+    /* queue_limit bounds the packets the sends keep in the send queue, a
+       message is passed down only if all of its packets fit */
+    Connection(int queue_limit_);
+    ~Connection();
+
+    /* run a coroutine from the start of the run on */
+    void spawn(Task task);
+
+    /* pass size bytes at data down on a stream (0 unless the rdt layer has
+       streams), they must stay valid until the send resumes */
+    SendAwaiter send(const char *data, int size, int stream = 0) {
+	SendOp op = {data, size, stream, 0, nullptr};
+	return SendAwaiter(this, op);
+    }
+    SendAwaiter send(const std::string &data, int stream = 0) {
+	return send(data.data(), (int) data.size(), stream);
+    }
+
+    /* the next message delivered on a stream */
+    RecvAwaiter recv(int stream = 0) { return RecvAwaiter(this, stream); }
+
+    /* coroutines that had not finished when the run ended */
+    int unfinished();
+
+    double first_arrival();
+    double send_next();
+    void deliver(struct message *msg, int stream);
+    void sender_progress();
+};
+
+#endif  /* _RDT_ASYNC_H_ */
@@ -0,0 +1,344 @@
+/*
+ * FILE: rdt_bench.cc
+ * DESCRIPTION: Microbenchmarks for the hot paths of the rdt layer and the
+ *              simulator core.  The simulator routines the rdt layer calls
+ *              are replaced by stubs here, so each benchmark measures only
+ *              the code under test.
+ *       usage: rdt_bench [scale]
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <deque>
+
+#include "rdt_struct.h"
+#include "rdt_sender.h"
+#include "rdt_receiver.h"
+#include "rdt_util.h"
+#include "rdt_event.h"
+#include "rdt_workload.h"
+#include "rdt_compress.h"
+
+
+/*[]------------------------------------------------------------------------[]
+  |  simulator stubs
+  []------------------------------------------------------------------------[]*/
+
+static double bench_clock = 0;
+static bool bench_timer_set = false;
+static std::deque<packet> bench_wire;   /* packets sent by the sender */
+static long long bench_delivered = 0;   /* bytes given to the upper layer */
+
+double GetSimulationTime() { return bench_clock; }
+
+void Sender_StartTimer(double timeout) { bench_timer_set = true; }
+
+void Sender_StopTimer() { bench_timer_set = false; }
+
+bool Sender_isTimerSet() { return bench_timer_set; }
+
+void Sender_ToLowerLayer(struct packet *pkt) { bench_wire.push_back(*pkt); }
+
+void Receiver_ToLowerLayer(struct packet *pkt) {}
+
+void Receiver_ToUpperLayer(struct message *msg) { bench_delivered += msg->size; }
+void Receiver_ToUpperLayerOnStream(struct message *msg, int stream) { bench_delivered += msg->size; }
+
+bool Receiver_isUpperLayerBusy() { return false; }
+
+double myrandom() { return 0.5; }
+
+
+/*[]------------------------------------------------------------------------[]
+  |  benchmark helpers
+  []------------------------------------------------------------------------[]*/
+
+static double wall_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+/* keep the compiler from discarding a computed value */
+static volatile unsigned long long bench_sink;
+
+static void report(const char *name, long long ops, long long bytes, double seconds)
+{
+    fprintf(stdout, "%-28s %12lld ops %10.1f ns/op %10.2f Mops/s", name, ops,
+	    seconds*1e9/ops, ops/seconds/1e6);
+    if (bytes > 0)
+	fprintf(stdout, " %10.2f MB/s", bytes/seconds/1e6);
+    fprintf(stdout, "\n");
+}
+
+/* a full packet carrying sequence number seq, with a valid checksum */
+static void make_packet(packet *pkt, int seq, int size)
+{
+    Header h = {0, seq, size, 0, 0};
+    int offset = encode_header(pkt, &h);
+    for (int i = 0; i < size; ++i)
+	pkt->data[offset + i] = '0' + (seq + i) % 10;
+    build_checksum(pkt);
+}
+
+
+/*[]------------------------------------------------------------------------[]
+  |  benchmarks
+  []------------------------------------------------------------------------[]*/
+
+static void bench_checksum(long long n)
+{
+    packet pkts[MAX_SEQ + 1];
+    for (int i = 0; i <= MAX_SEQ; ++i)
+	make_packet(&pkts[i], i, MAX_PAYLOAD);
+
+    unsigned long long sum = 0;
+    double start = wall_time();
+    for (long long i = 0; i < n; ++i)
+	sum += calc_checksum(&pkts[i % (MAX_SEQ + 1)]);
+    double seconds = wall_time() - start;
+    bench_sink = sum;
+    report("calc_checksum", n, n*PAYLOAD_END, seconds);
+}
+
+/* the headers of a full data packet, the last packet of a message, a packet
+   on a stream and an ack in turn, written and then read back */
+static void bench_header(long long n)
+{
+    Header kinds[4] = {
+	{0, 0, MAX_PAYLOAD, 0, 0},
+	{0, 0, 40, 0, 0},
+	{FLAG_STREAM, 0, 60, 5, 200},
+	{0, 0, ACK_SIZE, 0, 0},
+    };
+    packet pkts[4];
+
+    long long sum = 0;
+    double start = wall_time();
+    for (long long i = 0; i < n; ++i) {
+	Header h = kinds[i & 3];
+	h.seq = i % (MAX_SEQ + 1);
+	sum += encode_header(&pkts[i & 3], &h);
+    }
+    double seconds = wall_time() - start;
+    report("encode_header", n, 0, seconds);
+
+    start = wall_time();
+    for (long long i = 0; i < n; ++i) {
+	Header h;
+	sum += decode_header(&pkts[i & 3], &h) + h.size;
+    }
+    seconds = wall_time() - start;
+    bench_sink = sum;
+    report("decode_header", n, 0, seconds);
+}
+
+/* check_packet() one packet at a time against check_packets() on batches */
+static void bench_check_batch(long long n, int batch)
+{
+    packet pkts[MAX_BATCH];
+    packet *ptrs[MAX_BATCH];
+    bool ok[MAX_BATCH];
+    for (int i = 0; i < batch; ++i) {
+	make_packet(&pkts[i], i % (MAX_SEQ + 1), MAX_PAYLOAD);
+	ptrs[i] = &pkts[i];
+    }
+
+    long long good = 0;
+    double start = wall_time();
+    for (long long i = 0; i < n; i += batch)
+	for (int j = 0; j < batch; ++j)
+	    good += check_packet(ptrs[j]);
+    double seconds = wall_time() - start;
+    report("check_packet", n, n*PAYLOAD_END, seconds);
+
+    start = wall_time();
+    for (long long i = 0; i < n; i += batch) {
+	check_packets(ptrs, batch, ok);
+	for (int j = 0; j < batch; ++j) good += ok[j];
+    }
+    seconds = wall_time() - start;
+    bench_sink = good;
+    char name[32];
+    snprintf(name, sizeof(name), "check_packets/%d", batch);
+    report(name, n, n*PAYLOAD_END, seconds);
+}
+
+/* the receiver's ack of a packet delivered in order, with the whole receive
+   buffer free */
+static void make_ack(packet *ack, int seq)
+{
+    Header h = {0, seq, ACK_SIZE, 0, 0};
+    int offset = encode_header(ack, &h);
+    ack->data[offset] = (char) (seq == MAX_SEQ ? 0 : seq + 1);
+    ack->data[offset + 1] = RECV_BUFFER;
+    build_checksum(ack);
+}
+
+/* every message is packetized, sent and then acked in order, so the window
+   and the send queue stay bounded */
+static void bench_sender(long long n, int msg_size)
+{
+    message msg;
+    msg.size = msg_size;
+    msg.data = (char*) malloc(msg_size);
+    for (int i = 0; i < msg_size; ++i) msg.data[i] = '0' + i % 10;
+
+    Sender_Init();
+    double start = wall_time();
+    for (long long i = 0; i < n; ++i) {
+	Sender_FromUpperLayer(&msg);
+	while (!bench_wire.empty()) {
+	    packet ack;
+	    make_ack(&ack, packet_seq(&bench_wire.front()));
+	    bench_wire.pop_front();
+	    Sender_FromLowerLayer(&ack);
+	}
+    }
+    double seconds = wall_time() - start;
+    free(msg.data);
+
+    char name[64];
+    snprintf(name, sizeof(name), "Sender_FromUpperLayer/%d", msg_size);
+    report(name, n, n*msg_size, seconds);
+}
+
+static void bench_receiver(long long n)
+{
+    packet pkts[MAX_SEQ + 1];
+    for (int i = 0; i <= MAX_SEQ; ++i)
+	make_packet(&pkts[i], i, MAX_PAYLOAD);
+
+    Receiver_Init();
+    bench_delivered = 0;
+    double start = wall_time();
+    for (long long i = 0; i < n; ++i)
+	Receiver_FromLowerLayer(&pkts[i % (MAX_SEQ + 1)]);
+    double seconds = wall_time() - start;
+    if (bench_delivered != n*MAX_PAYLOAD)
+	fprintf(stderr, "Receiver_FromLowerLayer delivered %lld of %lld bytes\n",
+		bench_delivered, n*MAX_PAYLOAD);
+    report("Receiver_FromLowerLayer", n, bench_delivered, seconds);
+}
+
+/* the generator fills and the upper layer at the receiver verifies every
+   byte of the session */
+static void bench_pattern(long long n, int msg_size, Pattern::Kind kind)
+{
+    Pattern pattern(kind);
+    char *data = (char*) malloc(msg_size);
+
+    double start = wall_time();
+    long long mismatches = 0;
+    for (long long i = 0; i < n; ++i) {
+	pattern.fill(data, msg_size);
+	if (pattern.verify(data, msg_size) >= 0) mismatches++;
+    }
+    double seconds = wall_time() - start;
+    free(data);
+    if (mismatches)
+	fprintf(stderr, "Pattern verify failed %lld times\n", mismatches);
+
+    char name[64];
+    snprintf(name, sizeof(name), "Pattern %s/%d", kind == Pattern::DIGITS ? "digits" : "random",
+	     msg_size);
+    report(name, n, n*msg_size, seconds);
+}
+
+/* packetize a message of the pattern the way the sender does with
+   --compress, then expand every packet again */
+static void bench_compress(long long n, int msg_size, Pattern::Kind kind)
+{
+    Pattern pattern(kind);
+    char *data = (char*) malloc(msg_size);
+    char payload[MAX_PAYLOAD], expanded[COMPRESS_MAX_INPUT];
+    pattern.fill(data, msg_size);
+
+    long long packets = 0, payload_bytes = 0, mismatches = 0;
+    double compress_seconds = 0, decompress_seconds = 0;
+    for (long long i = 0; i < n; ++i) {
+	for (int cursor = 0; cursor < msg_size; ) {
+	    int used;
+	    double start = wall_time();
+	    int size = rdt_compress(data + cursor, msg_size - cursor, payload, MAX_PAYLOAD, &used);
+	    compress_seconds += wall_time() - start;
+	    start = wall_time();
+	    int m = rdt_decompress(payload, size, expanded, COMPRESS_MAX_INPUT);
+	    decompress_seconds += wall_time() - start;
+	    if (m != used || memcmp(expanded, data + cursor, used) != 0) mismatches++;
+	    packets++;
+	    payload_bytes += size;
+	    cursor += used;
+	}
+    }
+    free(data);
+    if (mismatches)
+	fprintf(stderr, "rdt_decompress mismatched %lld packets\n", mismatches);
+
+    char name[64];
+    const char *kind_name = kind == Pattern::DIGITS ? "digits" : "random";
+    snprintf(name, sizeof(name), "rdt_compress %s/%d", kind_name, msg_size);
+    report(name, n, n*msg_size, compress_seconds);
+    snprintf(name, sizeof(name), "rdt_decompress %s/%d", kind_name, msg_size);
+    report(name, n, n*msg_size, decompress_seconds);
+    fprintf(stdout, "%-28s %12.2f ratio %10.1f packets/msg\n", "", 
+	    (double)n*msg_size/payload_bytes, (double)packets/n);
+}
+
+/* the classic hold model: a steady population of events, each step pops the
+   earliest one and reschedules it a pseudo-random interval later */
+static void bench_eventchain(long long n, int population)
+{
+    EventChain chain;
+    Event *events = new Event[population];
+    unsigned int lcg = 12345;
+    for (int i = 0; i < population; ++i) {
+	lcg = lcg*1103515245 + 12345;
+	events[i].sched_time = (lcg >> 8) * (1.0/(1 << 24));
+	chain.schedule(&events[i]);
+    }
+
+    double start = wall_time();
+    for (long long i = 0; i < n; ++i) {
+	Event *e = chain.next_event();
+	lcg = lcg*1103515245 + 12345;
+	e->sched_time = chain.time() + (lcg >> 8) * (1.0/(1 << 24));
+	chain.schedule(e);
+    }
+    double seconds = wall_time() - start;
+    delete[] events;
+
+    char name[64];
+    snprintf(name, sizeof(name), "EventChain hold/%d", population);
+    report(name, n, 0, seconds);
+}
+
+
+int main(int argc, char *argv[])
+{
+    double scale = argc > 1 ? atof(argv[1]) : 1.0;
+    if (scale <= 0) {
+	fprintf(stderr, "usage: %s [scale]\n", argv[0]);
+	exit(-1);
+    }
+
+    bench_header((long long)(50000000*scale));
+    bench_checksum((long long)(20000000*scale));
+    bench_check_batch((long long)(20000000*scale), 8);
+    bench_sender((long long)(200000*scale), 100);
+    bench_sender((long long)(20000*scale), 4096);
+    bench_receiver((long long)(5000000*scale));
+    bench_pattern((long long)(5000000*scale), 100, Pattern::DIGITS);
+    bench_pattern((long long)(200000*scale), 4096, Pattern::DIGITS);
+    bench_pattern((long long)(200000*scale), 4096, Pattern::RANDOM);
+    bench_compress((long long)(20000*scale), 4096, Pattern::DIGITS);
+    bench_compress((long long)(2000*scale), 4096, Pattern::RANDOM);
+    bench_eventchain((long long)(5000000*scale), 16);
+    bench_eventchain((long long)(500000*scale), 256);
+
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include "rdt_channel.h"
+#include "rdt_checkpoint.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+bool GilbertElliottLoss::lose() {
+    if (bad) {
+        if (myrandom() < p_bg) bad = false;
+    } else {
+        if (myrandom() < p_gb) bad = true;
+    }
+    return myrandom() < (bad ? loss_bad : loss_good);
+}
+
+void GilbertElliottLoss::checkpoint(Checkpoint &ck) {
+    ck.value(bad);
+}
+
+double ReorderDelay::delay() {
+    if (myrandom() < outoforder_rate)
+        return latency * 2.0 * myrandom();
+    return latency;
+}
+
+double ParetoDelay::delay() {
+    double u = myrandom();
+    if (u <= 0) u = 1e-12;
+    return base + scale * (pow(u, -1.0 / alpha) - 1.0);
+}
+
+bool TraceDelay::load(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) return false;
+    double d;
+    while (fscanf(fp, "%lf", &d) == 1) {
+        if (d < 0) {
+            fclose(fp);
+            return false;
+        }
+        if (delays.empty() || d < lowest) lowest = d;
+        if (delays.empty() || d > highest) highest = d;
+        delays.push_back(d);
+    }
+    fclose(fp);
+    return !delays.empty();
+}
+
+double TraceDelay::delay() {
+    double d = delays[cursor];
+    if (++cursor == delays.size()) cursor = 0;
+    return d;
+}
+
+void TraceDelay::checkpoint(Checkpoint &ck) {
+    ck.value(cursor);
+    if (cursor >= delays.size()) cursor = 0; // restored with a shorter trace
+}
+
+int parse_spec(const char *spec, const char *name, double *args, int max_args) {
+    size_t len = strlen(name);
+    if (strncmp(spec, name, len) != 0 || spec[len] != ':') return -1;
+    const char *p = spec + len + 1;
+    int n = 0;
+    while (*p && n < max_args) {
+        char *end;
+        args[n++] = strtod(p, &end);
+        if (end == p) return -1;
+        if (*end == ',') end++;
+        else if (*end) return -1;
+        p = end;
+    }
+    return *p ? -1 : n;
+}
+
+bool is_prob(double x) {
+    return x >= 0 && x <= 1;
+}
+
+LossModel *make_loss_model(const char *spec) {
+    double a[4];
+    int n;
+    if ((n = parse_spec(spec, "bernoulli", a, 1)) == 1 && is_prob(a[0]))
+        return new BernoulliLoss(a[0]);
+    if ((n = parse_spec(spec, "ge", a, 4)) >= 2) {
+        if (n < 3) a[2] = 0;
+        if (n < 4) a[3] = 1;
+        if (is_prob(a[0]) && is_prob(a[1]) && is_prob(a[2]) && is_prob(a[3]))
+            return new GilbertElliottLoss(a[0], a[1], a[2], a[3]);
+    }
+    return NULL;
+}
+
+DelayModel *make_delay_model(const char *spec) {
+    double a[3];
+    if (parse_spec(spec, "reorder", a, 2) == 2 && a[0] >= 0 && is_prob(a[1]))
+        return new ReorderDelay(a[0], a[1]);
+    if (parse_spec(spec, "constant", a, 1) == 1 && a[0] >= 0)
+        return new ConstantDelay(a[0]);
+    if (parse_spec(spec, "uniform", a, 2) == 2 && a[0] >= 0 && a[1] >= a[0])
+        return new UniformDelay(a[0], a[1]);
+    if (parse_spec(spec, "pareto", a, 3) == 3 && a[0] >= 0 && a[1] >= 0 && a[2] > 0)
+        return new ParetoDelay(a[0], a[1], a[2]);
+    if (strncmp(spec, "trace:", 6) == 0) {
+        TraceDelay *model = new TraceDelay;
+        if (model->load(spec + 6)) return model;
+        delete model;
+    }
+    return NULL;
+}
@@ -0,0 +1,170 @@
+/*
+ * FILE: rdt_channel.h
+ * DESCRIPTION: Channel models of the simulator.  Each direction of the link
+ *              has a loss model, deciding whether a packet is dropped, and a
+ *              delay model, deciding when it arrives at the other side.
+ *
+ *       loss models:  bernoulli:<p>
+ *                     ge:<p_gb>,<p_bg>[,<loss_good>[,<loss_bad>]]
+ *       delay models: reorder:<latency>,<outoforder_rate>
+ *                     constant:<d>
+ *                     uniform:<lo>,<hi>
+ *                     pareto:<base>,<scale>,<alpha>
+ *                     trace:<file>
+ */
+
+
+#ifndef _RDT_CHANNEL_H_
+#define _RDT_CHANNEL_H_
+
+#include <stddef.h>
+#include <vector>
+
+/* generate a random number in [0,1], provided by the simulator */
+double myrandom();
+
+class Checkpoint;
+
+/* decides whether a packet is lost */
+class LossModel
+{
+public:
+    virtual ~LossModel() {}
+    virtual bool lose() = 0;
+    /* save or restore the state the model keeps between packets */
+    virtual void checkpoint(Checkpoint &ck) {}
+};
+
+/* independent per-packet loss */
+class BernoulliLoss : public LossModel
+{
+public:
+    double rate;
+
+public:
+    BernoulliLoss(double rate_) : rate(rate_) {}
+    bool lose() { return myrandom() < rate; }
+};
+
+/* Gilbert-Elliott two-state burst loss: the channel moves from the good to
+   the bad state with probability p_gb and back with p_bg before each packet,
+   and loses the packet with the loss rate of the state it is in */
+class GilbertElliottLoss : public LossModel
+{
+public:
+    double p_gb, p_bg;
+    double loss_good, loss_bad;
+    bool bad;
+
+public:
+    GilbertElliottLoss(double p_gb_, double p_bg_, double loss_good_, double loss_bad_)
+        : p_gb(p_gb_), p_bg(p_bg_), loss_good(loss_good_), loss_bad(loss_bad_), bad(false) {}
+    bool lose();
+    void checkpoint(Checkpoint &ck);
+};
+
+/* decides how long a packet stays on the link */
+class DelayModel
+{
+public:
+    virtual ~DelayModel() {}
+    virtual double delay() = 0;
+    /* a lower bound of every delay() */
+    virtual double min_delay() = 0;
+    /* an upper bound of every delay(), -1 if there is none */
+    virtual double max_delay() = 0;
+    /* save or restore the state the model keeps between packets */
+    virtual void checkpoint(Checkpoint &ck) {}
+};
+
+/* the original model: the normal latency, except that a fraction of the
+   packets take a uniform delay in [0, 2*latency] and are reordered */
+class ReorderDelay : public DelayModel
+{
+public:
+    double latency, outoforder_rate;
+
+public:
+    ReorderDelay(double latency_, double rate_) : latency(latency_), outoforder_rate(rate_) {}
+    double delay();
+    double min_delay() { return outoforder_rate > 0 ? 0 : latency; }
+    double max_delay() { return outoforder_rate > 0 ? 2 * latency : latency; }
+};
+
+class ConstantDelay : public DelayModel
+{
+public:
+    double d;
+
+public:
+    ConstantDelay(double d_) : d(d_) {}
+    double delay() { return d; }
+    double min_delay() { return d; }
+    double max_delay() { return d; }
+};
+
+class UniformDelay : public DelayModel
+{
+public:
+    double lo, hi;
+
+public:
+    UniformDelay(double lo_, double hi_) : lo(lo_), hi(hi_) {}
+    double delay() { return lo + (hi - lo)*myrandom(); }
+    double min_delay() { return lo; }
+    double max_delay() { return hi; }
+};
+
+/* a fixed base latency plus heavy-tailed (Pareto type II) jitter */
+class ParetoDelay : public DelayModel
+{
+public:
+    double base, scale, alpha;
+
+public:
+    ParetoDelay(double base_, double scale_, double alpha_) : base(base_), scale(scale_), alpha(alpha_) {}
+    double delay();
+    double min_delay() { return base; }
+    double max_delay() { return scale > 0 ? -1 : base; }
+};
+
+/* replays the delays listed in a file (one per line, in seconds), wrapping
+   around at the end */
+class TraceDelay : public DelayModel
+{
+public:
+    std::vector<double> delays;
+    size_t cursor;
+    double lowest, highest;
+
+public:
+    TraceDelay() : cursor(0), lowest(0), highest(0) {}
+    bool load(const char *path);
+    double delay();
+    double min_delay() { return lowest; }
+    double max_delay() { return highest; }
+    void checkpoint(Checkpoint &ck);
+};
+
+/* one direction of the link */
+struct Channel {
+    LossModel *loss;
+    DelayModel *delay;
+    long long offered;      // packets handed to the channel
+    long long lost;
+    long long corrupted;
+};
+
+/* split the spec "name:a,b,c" into up to max_args numbers, return how many
+   there were, or -1 if the spec is not of this name or is malformed */
+int parse_spec(const char *spec, const char *name, double *args, int max_args);
+
+bool is_prob(double x);
+
+/* build a model from its command line spec, return NULL if the spec is
+   invalid */
+LossModel *make_loss_model(const char *spec);
+
+DelayModel *make_delay_model(const char *spec);
+
+#endif  /* _RDT_CHANNEL_H_ */
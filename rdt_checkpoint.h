@@ -0,0 +1,135 @@
+//
+// Checkpoints of a simulation: one Checkpoint object writes the state of
+// every module, or reads it back in the same order.  A module has a single
+// checkpoint routine for both directions, so what is saved and what is
+// restored cannot drift apart.
+//
+// Values are stored raw in the layout of this build, a checkpoint is meant
+// to be restored by the same binary.  The header records the packet size
+// and the layout of the containers, and a mismatch fails the restore.
+//
+
+#ifndef RDT_RDT_CHECKPOINT_H
+#define RDT_RDT_CHECKPOINT_H
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <queue>
+#include <list>
+#include <map>
+#include <typeinfo>
+
+class Checkpoint
+{
+public:
+    FILE *fp;                   // NULL for a block kept in buf
+    bool writing;
+    bool ok;                    // false after a short read or write, or a mismatch
+    std::vector<char> buf;
+    size_t pos;
+
+public:
+    Checkpoint(FILE *fp_, bool writing_) : fp(fp_), writing(writing_), ok(true), pos(0) {}
+
+    /* write or read n bytes at p */
+    void io(void *p, size_t n) {
+        if (!ok || n == 0) return;
+        if (fp != NULL)
+            ok = (writing ? fwrite(p, 1, n, fp) : fread(p, 1, n, fp)) == n;
+        else if (writing)
+            buf.insert(buf.end(), (char*) p, (char*) p + n);
+        else if (pos + n > buf.size())
+            ok = false;
+        else {
+            memcpy(p, &buf[pos], n);
+            pos += n;
+        }
+    }
+
+    template <class T> void value(T &v) { io(&v, sizeof(v)); }
+
+    template <class T> void array(T *v, size_t n) { io(v, sizeof(T) * n); }
+
+    /* a value that must be the same when restored, e.g. a build setting */
+    template <class T> void expect(T v) {
+        T got = v;
+        value(got);
+        if (!writing && got != v) ok = false;
+    }
+
+    void string(std::string &s) {
+        size_t n = s.size();
+        value(n);
+        if (!writing) {
+            if (!ok || n > 4096) { ok = false; return; }
+            s.resize(n);
+        }
+        if (n > 0) io(&s[0], n);
+    }
+
+    /* vector, deque and list of values */
+    template <class C> void sequence(C &c) {
+        size_t n = c.size();
+        value(n);
+        if (writing) {
+            for (typename C::iterator it = c.begin(); ok && it != c.end(); ++it) value(*it);
+            return ;
+        }
+        c.clear();
+        for (size_t i = 0; ok && i < n; ++i) {
+            typename C::value_type v;
+            value(v);
+            if (ok) c.push_back(v);
+        }
+    }
+
+    template <class T> void queue(std::queue<T> &q) {
+        std::deque<T> items;
+        if (writing)
+            for (std::queue<T> copy = q; !copy.empty(); copy.pop()) items.push_back(copy.front());
+        sequence(items);
+        if (!writing) q = std::queue<T>(items);
+    }
+
+    template <class K, class V> void map(std::map<K, V> &m) {
+        size_t n = m.size();
+        value(n);
+        if (writing) {
+            for (typename std::map<K, V>::iterator it = m.begin(); ok && it != m.end(); ++it) {
+                K k = it->first;
+                value(k);
+                value(it->second);
+            }
+            return ;
+        }
+        m.clear();
+        for (size_t i = 0; ok && i < n; ++i) {
+            K k;
+            V v;
+            value(k);
+            value(v);
+            if (ok) m[k] = v;
+        }
+    }
+
+    /* the state of a model (a loss, delay or workload model) in a block of
+       its own, tagged with its class.  a run restored with a model of
+       another kind keeps its fresh model and skips the block, so what-if
+       runs can change the models of a checkpoint */
+    template <class M> void model(M *m) {
+        std::string kind = typeid(*m).name();
+        Checkpoint block(NULL, writing);
+        if (writing) m->checkpoint(block);
+        string(kind);
+        sequence(block.buf);
+        if (!writing && ok && kind == typeid(*m).name()) {
+            m->checkpoint(block);
+            if (!block.ok || block.pos != block.buf.size()) ok = false;
+        }
+    }
+};
+
+#endif //RDT_RDT_CHECKPOINT_H
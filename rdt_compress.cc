@@ -0,0 +1,118 @@
+#include "rdt_compress.h"
+#include <string.h>
+
+#define HASH_BITS 11
+
+// positions + 1 of the last 4-byte sequences seen, 0 if none
+static unsigned short hash_table[1 << HASH_BITS];
+
+static inline unsigned int hash4(const char *p) {
+    unsigned int x;
+    memcpy(&x, p, 4);
+    return (x * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// output bytes of n literals, every run of up to 128 has a control byte
+static inline int literal_cost(int n) {
+    return n + (n + COMPRESS_MAX_LITERALS - 1) / COMPRESS_MAX_LITERALS;
+}
+
+static int put_literals(const char *lit, int n, char *out) {
+    int op = 0;
+    while (n > 0) {
+        int run = n < COMPRESS_MAX_LITERALS ? n : COMPRESS_MAX_LITERALS;
+        out[op++] = (char)(run - 1);
+        memcpy(out + op, lit, run);
+        op += run;
+        lit += run;
+        n -= run;
+    }
+    return op;
+}
+
+// length of the common prefix of a and b, at most max_len
+static inline int match_length(const char *a, const char *b, int max_len) {
+    int len = 0;
+    while (len + 8 <= max_len) {
+        unsigned long long x, y;
+        memcpy(&x, a + len, 8);
+        memcpy(&y, b + len, 8);
+        if (x != y) return len + __builtin_ctzll(x ^ y) / 8;
+        len += 8;
+    }
+    while (len < max_len && a[len] == b[len]) len++;
+    return len;
+}
+
+int rdt_compress(const char *in, int in_size, char *out, int out_cap, int *consumed) {
+    if (in_size > COMPRESS_MAX_INPUT) in_size = COMPRESS_MAX_INPUT;
+    memset(hash_table, 0, sizeof(hash_table));
+    int ip = 0, anchor = 0, op = 0;
+    bool full = false;
+    while (ip + COMPRESS_MIN_MATCH <= in_size) {
+        if (ip - anchor >= out_cap - op) { // not even the pending literals fit
+            full = true;
+            break;
+        }
+        unsigned int h = hash4(in + ip);
+        int cand = hash_table[h] - 1;
+        hash_table[h] = (unsigned short)(ip + 1);
+        if (cand < 0 || memcmp(in + cand, in + ip, COMPRESS_MIN_MATCH) != 0) {
+            ip++;
+            continue;
+        }
+        int max_len = in_size - ip < COMPRESS_MAX_MATCH ? in_size - ip : COMPRESS_MAX_MATCH;
+        int len = COMPRESS_MIN_MATCH + match_length(in + cand + COMPRESS_MIN_MATCH,
+                in + ip + COMPRESS_MIN_MATCH, max_len - COMPRESS_MIN_MATCH);
+        if (op + literal_cost(ip - anchor) + 3 > out_cap) {
+            full = true;
+            break;
+        }
+        op += put_literals(in + anchor, ip - anchor, out + op);
+        int offset = ip - cand;
+        out[op++] = (char)(0x80 | (len - COMPRESS_MIN_MATCH));
+        out[op++] = (char)(offset >> 8);
+        out[op++] = (char) offset;
+        ip += len;
+        anchor = ip;
+    }
+    // the literals left over, as many of them as still fit
+    int n = (full ? ip : in_size) - anchor;
+    int room = out_cap - op;
+    int fit = room - (room + COMPRESS_MAX_LITERALS) / (COMPRESS_MAX_LITERALS + 1);
+    if (n > fit) n = fit;
+    op += put_literals(in + anchor, n, out + op);
+    *consumed = anchor + n;
+    return op;
+}
+
+int rdt_decompress(const char *in, int in_size, char *out, int out_cap) {
+    int ip = 0, op = 0;
+    while (ip < in_size) {
+        unsigned char token = in[ip++];
+        if (token < 0x80) {
+            int run = token + 1;
+            if (ip + run > in_size || op + run > out_cap) return -1;
+            memcpy(out + op, in + ip, run);
+            ip += run;
+            op += run;
+        } else {
+            int len = (token & 0x7F) + COMPRESS_MIN_MATCH;
+            if (ip + 2 > in_size) return -1;
+            int offset = ((unsigned char) in[ip] << 8) | (unsigned char) in[ip + 1];
+            ip += 2;
+            if (offset == 0 || offset > op || op + len > out_cap) return -1;
+            const char *src = out + op - offset;
+            int i = 0;
+            if (offset >= len) {
+                memcpy(out + op, src, len);
+                i = len;
+            } else if (offset >= 8) { // overlapping, but 8 bytes at a time do not
+                for (; i + 8 <= len; i += 8) memcpy(out + op + i, src + i, 8);
+            }
+            for (; i < len; ++i) out[op + i] = src[i]; // a run repeating a short period
+            op += len;
+        }
+    }
+    return op;
+}
@@ -0,0 +1,30 @@
+//
+// A small LZ77 codec for the payload of a single packet.
+//
+// Every packet is compressed on its own, so the receiver can expand it
+// whatever order the packets arrive in.  The compressed stream is a list of
+// tokens:
+//
+//   |0|  len-1  | len literal bytes              (len 1..128)
+//   |1|  len-4  | offset hi | offset lo          copy len bytes from offset
+//                                                bytes back (len 4..131)
+//
+
+#ifndef RDT_RDT_COMPRESS_H
+#define RDT_RDT_COMPRESS_H
+
+#define COMPRESS_MAX_INPUT 4096     // bytes one packet expands to at most
+#define COMPRESS_MIN_MATCH 4
+#define COMPRESS_MAX_MATCH (COMPRESS_MIN_MATCH + 127)
+#define COMPRESS_MAX_LITERALS 128
+
+/* compress a prefix of in[0..in_size) into at most out_cap bytes, as long a
+   prefix as fits.  return the compressed size and store the length of the
+   prefix in *consumed */
+int rdt_compress(const char *in, int in_size, char *out, int out_cap, int *consumed);
+
+/* expand in[0..in_size) into out, return the expanded size, or -1 if the
+   stream is malformed or expands beyond out_cap */
+int rdt_decompress(const char *in, int in_size, char *out, int out_cap);
+
+#endif //RDT_RDT_COMPRESS_H
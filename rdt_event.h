@@ -0,0 +1,162 @@
+/*
+ * FILE: rdt_event.h
+ * DESCRIPTION: The generic event chain framework of the simulator, shared by 
+ *              rdt_sim and the benchmarks.
+ */
+
+
+#ifndef _RDT_EVENT_H_
+#define _RDT_EVENT_H_
+
+#include <stddef.h>
+#include <sched.h>
+#include <atomic>
+
+
+/*[]------------------------------------------------------------------------[]
+  |  generic event chain framework
+  []------------------------------------------------------------------------[]*/
+
+/* simulation event base class */
+class Event
+{
+public:
+    double sched_time;      /* scheduled occuring time */
+    int event_type;         /* application-specific event type */
+    class Event *next;      /* next event in the chain */
+    int origin;             /* partition that scheduled the event */
+    long long order;        /* how many events the origin scheduled before */
+
+public:
+    Event() { next = NULL; origin = 0; order = 0; }
+
+    /* events of the same sched_time are ordered by who scheduled them and 
+       when, a total order that does not depend on how the partitions of a 
+       parallel run interleave */
+    bool before(const Event *e) const {
+	if (sched_time!=e->sched_time) return sched_time<e->sched_time;
+	if (origin!=e->origin) return origin<e->origin;
+	return order<e->order;
+    }
+};
+
+/* event chain class - the simulation core */
+class EventChain
+{
+public:
+    double sim_time;        /* simulation time */
+    Event *head;            /* head event in the chain */
+
+public:
+    EventChain() {
+	sim_time = 0;
+	head = NULL;
+    }
+    
+    double time() { return sim_time; }
+    
+    /* schedule an event - the event chain is maintained on an increasing order 
+       of sched_time, see Event::before() */
+    void schedule(Event *e) {
+	/* do nothing if the event is schedule for the past */
+	if (e->sched_time<sim_time) return;
+
+	Event **ppcur = &head;
+	while ((*ppcur!=NULL) && (*ppcur)->before(e))
+	    ppcur = &((*ppcur)->next);
+
+	e->next = *ppcur;
+	*ppcur = e;
+    }
+
+    /* cancel an event scheduled for happening in the future */
+    void cancel(Event *e) {
+	Event **ppcur = &head;
+	while ((*ppcur!=NULL) && (*ppcur!=e))
+	    ppcur = &((*ppcur)->next);
+
+	if (*ppcur==e) *ppcur=(*ppcur)->next;
+    }
+
+    /* advance to the next event */
+    Event *next_event() {
+	if (head==NULL) return NULL;
+
+	Event *e = head;
+	head = head->next;
+	sim_time = e->sched_time;
+
+	return e;
+    }
+
+    /* time of the next event, or -1 if there is none */
+    double next_time() { return head==NULL ? -1 : head->sched_time; }
+};
+
+/* lock-free single-producer single-consumer queue, used to pass events 
+   between the partitions of a parallel simulation */
+class Mailbox
+{
+private:
+    struct Node {
+	Event *e;
+	std::atomic<Node*> next;
+    };
+    Node *head;             /* consumer side, a consumed stub node */
+    Node *tail;             /* producer side */
+
+public:
+    Mailbox() {
+	head = tail = new Node;
+	head->e = NULL;
+	head->next.store(NULL, std::memory_order_relaxed);
+    }
+
+    ~Mailbox() {
+	while (pop()!=NULL) ;
+	delete head;
+    }
+
+    void push(Event *e) {
+	Node *n = new Node;
+	n->e = e;
+	n->next.store(NULL, std::memory_order_relaxed);
+	tail->next.store(n, std::memory_order_release);
+	tail = n;
+    }
+
+    /* the oldest event in the mailbox, or NULL if it is empty */
+    Event *pop() {
+	Node *n = head->next.load(std::memory_order_acquire);
+	if (n==NULL) return NULL;
+	delete head;
+	head = n;
+	return n->e;
+    }
+};
+
+/* barrier of the threads of a parallel simulation.  the windows between two 
+   barriers are short, so it spins before it yields */
+class SpinBarrier
+{
+private:
+    int parties;
+    std::atomic<int> arrived;
+    std::atomic<unsigned> phase;
+
+public:
+    SpinBarrier(int n) : parties(n), arrived(0), phase(0) {}
+
+    void wait() {
+	unsigned ph = phase.load(std::memory_order_acquire);
+	if (arrived.fetch_add(1, std::memory_order_acq_rel)+1==parties) {
+	    arrived.store(0, std::memory_order_relaxed);
+	    phase.fetch_add(1, std::memory_order_release);
+	    return;
+	}
+	for (int spins=0; phase.load(std::memory_order_acquire)==ph; spins++)
+	    if (spins>=100) sched_yield();
+    }
+};
+
+#endif  /* _RDT_EVENT_H_ */
@@ -0,0 +1,301 @@
+/*
+ * FILE: rdt_gbn.cc
+ * DESCRIPTION: Go-back-N and stop-and-wait, the GoBackN policy of rdt_arq.h.
+ *              Packets have the header of rdt_header.h without the stream
+ *              fields, as in selective repeat.  An ack carries
+ *              the next expected seq and the free receive buffer like a
+ *              selective repeat one, and the low byte of the count of
+ *              packets the receiver took in order.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include "rdt_struct.h"
+#include "rdt_sender.h"
+#include "rdt_receiver.h"
+#include "rdt_util.h"
+#include "rdt_arq.h"
+#include "rdt_checkpoint.h"
+
+
+/*[]------------------------------------------------------------------------[]
+  |  sender
+  []------------------------------------------------------------------------[]*/
+
+template <int N>
+void GoBackN<N>::sender_init()
+{
+    while (!packets.empty()) packets.pop();
+    base = next_seq = outstanding = 0;
+    stalled = false;
+    acked_count = 0;
+}
+
+/* fill the window from the send queue, the clock runs for the oldest packet */
+template <int N>
+void GoBackN<N>::try_send()
+{
+    while (outstanding < N && !packets.empty()) {
+        window[outstanding] = packets.front();
+        packets.pop();
+        sender_stats.queue_depth--;
+        send_time[outstanding] = GetSimulationTime();
+        resent[outstanding] = false;
+        sender_stats.first_sent++;
+        if (!Sender_isTimerSet()) Sender_StartTimer(TIMEOUT);
+        Sender_ToLowerLayer(&window[outstanding]);
+        outstanding++;
+    }
+    if (!packets.empty() && !stalled) sender_stats.window_stalls++;
+    stalled = !packets.empty();
+}
+
+template <int N>
+void GoBackN<N>::sender_from_upper(struct message *msg)
+{
+    int cursor = 0;
+    packet pkt = packet();
+    while (cursor < msg->size) {
+        Header h = {0, next_seq, 0, 0, 0};
+        h.size = payload_room(&h, msg->size - cursor);
+        inc(next_seq);
+        memcpy(pkt.data + encode_header(&pkt, &h), msg->data + cursor, h.size);
+        build_checksum(&pkt);
+        packets.push(pkt);
+        sender_stats.queued++;
+        if (++sender_stats.queue_depth > sender_stats.max_queue_depth)
+            sender_stats.max_queue_depth = sender_stats.queue_depth;
+        cursor += h.size;
+    }
+    try_send();
+}
+
+/* the first acked packets leave the window, the clock restarts for the
+   oldest one left */
+template <int N>
+void GoBackN<N>::slide(int acked)
+{
+    double now = GetSimulationTime();
+    for (int i = 0; i < acked; ++i) {
+        if (resent[i]) {
+            sender_stats.recovered++;
+            sender_stats.recovery_time += now - send_time[i];
+        }
+        inc(base);
+    }
+    acked_count += acked;
+    sender_stats.acked += acked;
+    outstanding -= acked;
+    for (int i = 0; i < outstanding; ++i) {
+        window[i] = window[i + acked];
+        send_time[i] = send_time[i + acked];
+        resent[i] = resent[i + acked];
+    }
+    if (outstanding > 0)
+        Sender_StartTimer(TIMEOUT);
+    else
+        Sender_StopTimer();
+}
+
+/* acks are cumulative: the next expected seq acks everything before it.
+   a window can slide by N on a single ack, so a reordered ack may be a few
+   windows old, more than the sequence space tells apart. how many packets
+   it acks is told by the count it carries */
+template <int N>
+void GoBackN<N>::handle_ack(struct packet *pkt)
+{
+    Header h;
+    int offset = decode_header(pkt, &h);
+    if (h.flags || h.size != GBN_ACK_SIZE || pkt->data[offset] > MAX_SEQ) {
+        sender_stats.corrupted++;
+        return ;
+    }
+    int expected = pkt->data[offset];
+    int acked = (unsigned char)(pkt->data[offset + ACK_SIZE] - (char) acked_count);
+    if (acked <= outstanding && acked != seq_distance(base, expected)) {
+        sender_stats.corrupted++; // a corruption the checksum missed
+        return ;
+    }
+    if (acked == 0) { // the receiver is still waiting for base
+        sender_stats.acks_duplicate++;
+        return ;
+    }
+    if (acked > outstanding) { // from before the window
+        sender_stats.acks_ignored++;
+        return ;
+    }
+    DEBUG("[GBN-ACK]Sender received ack up to seq = %d\n", expected);
+    sender_stats.acks_received++;
+    slide(acked);
+}
+
+template <int N>
+void GoBackN<N>::sender_from_lower(struct packet *pkt)
+{
+    if (!check_packet(pkt)) {
+        sender_stats.corrupted++;
+        return ;
+    }
+    handle_ack(pkt);
+    try_send();
+}
+
+template <int N>
+void GoBackN<N>::sender_from_lower_batch(struct packet **pkts, int n)
+{
+    bool ok[MAX_BATCH];
+    check_packets(pkts, n, ok);
+    for (int i = 0; i < n; ++i) {
+        if (ok[i])
+            handle_ack(pkts[i]);
+        else
+            sender_stats.corrupted++;
+    }
+    try_send();
+}
+
+/* go back: resend every packet in flight */
+template <int N>
+void GoBackN<N>::sender_timeout()
+{
+    DEBUG("[GBN-T]Timeout, resend %d packets from seq = %d\n", outstanding, base);
+    for (int i = 0; i < outstanding; ++i) {
+        resent[i] = true;
+        sender_stats.timeout_resent++;
+        Sender_ToLowerLayer(&window[i]);
+    }
+    if (outstanding > 0) Sender_StartTimer(TIMEOUT);
+}
+
+
+template <int N>
+void GoBackN<N>::sender_checkpoint(Checkpoint &ck)
+{
+    ck.queue(packets);
+    ck.array(window, N);
+    ck.array(send_time, N);
+    ck.array(resent, N);
+    ck.value(base);
+    ck.value(next_seq);
+    ck.value(outstanding);
+    ck.value(stalled);
+    ck.value(acked_count);
+}
+
+
+/*[]------------------------------------------------------------------------[]
+  |  receiver
+  []------------------------------------------------------------------------[]*/
+
+template <int N>
+void GoBackN<N>::receiver_init()
+{
+    ready.clear();
+    expected = 0;
+    taken = 0;
+}
+
+template <int N>
+void GoBackN<N>::send_ack()
+{
+    packet ack = packet();
+    Header h = {0, seq_distance(1, expected), GBN_ACK_SIZE, 0, 0};
+    int offset = encode_header(&ack, &h);
+    ack.data[offset] = (char) expected;
+    ack.data[offset + 1] = (char)(RECV_BUFFER - (int) ready.size());
+    ack.data[offset + ACK_SIZE] = (char) taken;
+    build_checksum(&ack);
+    Receiver_ToLowerLayer(&ack);
+    receiver_stats.acks_sent++;
+}
+
+template <int N>
+void GoBackN<N>::deliver_ready()
+{
+    while (!ready.empty() && !Receiver_isUpperLayerBusy()) {
+        packet &pkt = ready.front();
+        Header h;
+        message msg;
+        msg.data = pkt.data + decode_header(&pkt, &h);
+        msg.size = h.size;
+        if (msg.size > 0) Receiver_ToUpperLayer(&msg);
+        receiver_stats.delivered++;
+        ready.pop_front();
+    }
+}
+
+/* only the expected packet is taken.  a duplicate is answered with the ack
+   of the last in-order packet, in case the sender missed it; a packet ahead
+   of the expected one is not, an ack the sender would ignore is one more
+   stale ack in flight that a later window may mistake for its own.
+   return whether the packet is to be acked */
+template <int N>
+bool GoBackN<N>::take(struct packet *pkt)
+{
+    if (pkt->data[FLAGS_BYTE] & (FLAG_NAK | FLAG_COMPRESSED | FLAG_STREAM)) {
+        receiver_stats.corrupted++;
+        return false;
+    }
+    int seq = packet_seq(pkt);
+    if (seq != expected) {
+        DEBUG("[GBN-R]Receiver received seq = %d, but expect %d, drop it\n", seq, expected);
+        if (this_turn(seq, expected)) { // the one before it was lost, its timeout resends both
+            receiver_stats.out_of_order++;
+            return false;
+        }
+        receiver_stats.duplicates++;
+    } else if ((int) ready.size() >= RECV_BUFFER) { // the upper layer is behind
+        receiver_stats.window_drops++;
+    } else {
+        ready.push_back(*pkt);
+        inc(expected);
+        taken++;
+        if ((long long) ready.size() > receiver_stats.max_buffered)
+            receiver_stats.max_buffered = ready.size();
+        deliver_ready();
+    }
+    return true;
+}
+
+template <int N>
+void GoBackN<N>::receiver_from_lower(struct packet *pkt)
+{
+    if (!check_packet(pkt)) {
+        receiver_stats.corrupted++;
+        return ;
+    }
+    if (take(pkt)) send_ack();
+}
+
+/* acks are cumulative, the last one says all */
+template <int N>
+void GoBackN<N>::receiver_from_lower_batch(struct packet **pkts, int n)
+{
+    bool ok[MAX_BATCH], ack = false;
+    check_packets(pkts, n, ok);
+    for (int i = 0; i < n; ++i) {
+        if (!ok[i])
+            receiver_stats.corrupted++;
+        else if (take(pkts[i]))
+            ack = true;
+    }
+    if (ack) send_ack();
+}
+
+template <int N>
+void GoBackN<N>::receiver_upper_ready()
+{
+    deliver_ready();
+}
+
+template <int N>
+void GoBackN<N>::receiver_checkpoint(Checkpoint &ck)
+{
+    ck.sequence(ready);
+    ck.value(expected);
+    ck.value(taken);
+}
+
+template class GoBackN<MAX_WINDOW>;
+template class GoBackN<1>;
@@ -0,0 +1,121 @@
+//
+// The packet header: a flags byte, then only the fields the flags call for.
+//
+//   | flags | seq | length | stream | stream seq | payload ... | checksum |
+//
+//   flags       NAK 0x80, COMPRESSED 0x40, STREAM 0x20, LENGTH 0x10, and the
+//               seq in the low 4 bits while it is below 15
+//   seq         varint, only when the low 4 bits of the flags are 15
+//   length      varint payload size, only with LENGTH.  without it the
+//               payload runs up to the checksum
+//   stream      varint stream id, then the low byte of the packet's seq
+//               within the stream, only with STREAM
+//
+// A varint keeps 7 bits a byte, low bits first, the top bit set on every byte
+// but the last.  A data packet filled up to the checksum has a one-byte
+// header; the last packet of a message, an ack and a nak have two.
+//
+
+#ifndef RDT_RDT_HEADER_H
+#define RDT_RDT_HEADER_H
+
+#include "rdt_struct.h"
+
+#define TAIL_SIZE 2
+#define PAYLOAD_END (RDT_PKTSIZE - TAIL_SIZE)  // where the checksum starts
+#define FLAGS_BYTE 0
+#define FLAG_NAK 0x80       // receiver->sender, the payload lists the missing sequence numbers
+#define FLAG_COMPRESSED 0x40    // sender->receiver, the payload is compressed by rdt_compress()
+#define FLAG_STREAM 0x20    // sender->receiver, the stream fields follow
+#define FLAG_LENGTH 0x10    // the length field follows
+#define SEQ_INLINE 0x0F     // a seq below it is kept in the flags byte
+#define VARINT_MAX_BYTES 3  // 21 bits, more than any seq or length needs
+
+struct Header {
+    int flags;              // FLAG_NAK, FLAG_COMPRESSED and FLAG_STREAM
+    int seq;
+    int size;               // payload bytes
+    int stream, stream_seq; // with FLAG_STREAM
+};
+
+inline int varint_size(unsigned v) {
+    return 1 + (v >= 0x80) + (v >= 0x4000);
+}
+
+inline int write_varint(char *p, unsigned v) {
+    int n = 0;
+    for (; v >= 0x80; v >>= 7) p[n++] = (char)(v | 0x80);
+    p[n++] = (char) v;
+    return n;
+}
+
+/* the varint at p[*pos], *pos moves past it.  -1 if it is longer than
+   VARINT_MAX_BYTES */
+inline int read_varint(const char *p, int *pos) {
+    unsigned v = 0;
+    for (int i = 0; i < VARINT_MAX_BYTES; ++i) {
+        unsigned char b = p[*pos + i];
+        v |= (unsigned)(b & 0x7F) << (7 * i);
+        if (!(b & 0x80)) {
+            *pos += i + 1;
+            return (int) v;
+        }
+    }
+    return -1;
+}
+
+/* the payload of a packet filled up to the checksum, no length field */
+inline int payload_capacity(const Header *h) {
+    int fixed = 1 + (h->seq >= SEQ_INLINE ? varint_size(h->seq) : 0)
+        + (h->flags & FLAG_STREAM ? varint_size(h->stream) + 1 : 0);
+    return PAYLOAD_END - fixed;
+}
+
+/* how much of n bytes the next packet carries: a full packet, or all of
+   them if they fit with a length field */
+inline int payload_room(const Header *h, int n) {
+    int capacity = payload_capacity(h);
+    if (n >= capacity) return capacity;
+    if (n + varint_size(n) <= capacity) return n;
+    return capacity - varint_size(capacity);
+}
+
+/* write the header of h->size bytes of payload, a size payload_room() gave.
+   return where the payload starts */
+inline int encode_header(packet *pkt, const Header *h) {
+    char *p = pkt->data;
+    bool full = h->size == payload_capacity(h);
+    bool seq_inline = h->seq < SEQ_INLINE;
+    p[FLAGS_BYTE] = (char)(h->flags | (full ? 0 : FLAG_LENGTH) | (seq_inline ? h->seq : SEQ_INLINE));
+    int pos = 1;
+    if (!seq_inline) pos += write_varint(p + pos, h->seq);
+    if (!full) pos += write_varint(p + pos, h->size);
+    if (h->flags & FLAG_STREAM) {
+        pos += write_varint(p + pos, h->stream);
+        p[pos++] = (char) h->stream_seq;
+    }
+    return pos;
+}
+
+/* read the header, return where the payload starts, or -1 if the fields do
+   not fit in the packet */
+inline int decode_header(const packet *pkt, Header *h) {
+    const char *p = pkt->data;
+    unsigned char f = p[FLAGS_BYTE];
+    int pos = 1, size = 0;
+    h->flags = f & (FLAG_NAK | FLAG_COMPRESSED | FLAG_STREAM);
+    h->seq = f & SEQ_INLINE;
+    if (h->seq == SEQ_INLINE) h->seq = read_varint(p, &pos);
+    if (f & FLAG_LENGTH) size = read_varint(p, &pos);
+    h->stream = h->stream_seq = 0;
+    if (f & FLAG_STREAM) {
+        h->stream = read_varint(p, &pos);
+        h->stream_seq = (unsigned char) p[pos++];
+    }
+    h->size = f & FLAG_LENGTH ? size : PAYLOAD_END - pos;
+    if ((h->seq | size | h->stream | h->size) < 0 || pos + h->size > PAYLOAD_END)
+        return -1;
+    return pos;
+}
+
+#endif //RDT_RDT_HEADER_H
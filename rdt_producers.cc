@@ -0,0 +1,274 @@
+/*
+ * FILE: rdt_producers.cc
+ * DESCRIPTION: Concurrent producers over the coroutine interface of the
+ *              upper layers.  Every producer is a coroutine that sends its
+ *              messages one at a time, each co_await resuming when the
+ *              message is acked; consumer coroutines take the delivered
+ *              data apart again and check every producer's messages arrive
+ *              whole and in order.  The producers pipeline through the
+ *              rdt layer while the send queue stays bounded.
+ *       usage: rdt_producers [options] <producers> <messages> <msg_size>
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <string>
+#include <vector>
+
+#include "rdt_struct.h"
+#include "rdt_sender.h"
+#include "rdt_util.h"
+#include "rdt_arq.h"
+#include "rdt_channel.h"
+#include "rdt_simcore.h"
+#include "rdt_async.h"
+
+
+/* a message: the producer, its index (4 bytes, low byte first), then a
+   payload that depends on both */
+#define RECORD_HEADER 5
+
+static int num_producers, num_messages, msg_size;
+static bool use_streams = false;
+
+struct Producer {
+    int sent;
+    double total_latency, max_latency;  /* from the send to the ack */
+};
+
+static std::vector<Producer> producers;
+static std::vector<int> next_index;     /* the next message of each producer */
+static long long messages_delivered = 0;
+static long long bad_messages = 0;
+
+
+/*[]------------------------------------------------------------------------[]
+  |  the coroutines
+  []------------------------------------------------------------------------[]*/
+
+static void make_record(char *buf, int producer, int index)
+{
+    buf[0] = (char) producer;
+    for (int i=0; i<4; i++)
+	buf[1+i] = (char) (index >> (8*i));
+    for (int i=RECORD_HEADER; i<msg_size; i++)
+	buf[i] = 'a' + (producer*7 + index + i) % 26;
+}
+
+static Task produce(Connection &conn, int id)
+{
+    std::string buf(msg_size, '\0');
+    Producer *p = &producers[id];
+    for (int k=0; k<num_messages; k++) {
+	make_record(&buf[0], id, k);
+	double start = GetSimulationTime();
+	co_await conn.send(buf, use_streams ? id : 0);
+	double latency = GetSimulationTime() - start;
+	p->total_latency += latency;
+	if (latency>p->max_latency) p->max_latency = latency;
+	p->sent++;
+    }
+}
+
+/* the messages of a stream, in whatever pieces the rdt layer delivers them */
+static Task consume(Connection &conn, int stream, long long expected)
+{
+    std::string data;
+    std::string record(msg_size, '\0');
+    for (long long got=0; got<expected; ) {
+	data += co_await conn.recv(stream);
+	size_t used = 0;
+	for (; data.size()-used>=(size_t) msg_size; used += msg_size, got++) {
+	    int producer = (unsigned char) data[used];
+	    int index = 0;
+	    for (int i=0; i<4; i++)
+		index |= (unsigned char) data[used+1+i] << (8*i);
+	    if (producer>=num_producers || index!=next_index[producer]) {
+		bad_messages++;
+		continue;
+	    }
+	    make_record(&record[0], producer, index);
+	    if (memcmp(&record[0], data.data()+used, msg_size)!=0)
+		bad_messages++;
+	    next_index[producer]++;
+	    messages_delivered++;
+	}
+	data.erase(0, used);
+    }
+}
+
+
+/*[]------------------------------------------------------------------------[]
+  |  main routine
+  []------------------------------------------------------------------------[]*/
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [options] <producers> <messages> <msg_size>\n"
+	    "options:\n"
+	    "\t--loopback         run in real time over UDP on the loopback interface\n"
+	    "\t--batch            print key=value metrics\n"
+	    "\t--seed=N           seed the random number generator with N\n"
+	    "\t--loss=SPEC        loss model of both directions, as in rdt_sim (default none)\n"
+	    "\t--delay=SPEC       delay model of both directions, as in rdt_sim (default constant:0.1),\n"
+	    "\t                   ignored with --loopback\n"
+	    "\t--corrupt=P        corrupt packets with probability P\n"
+	    "\t--queue=N          packets the producers keep in the send queue at most (default 16),\n"
+	    "\t                   a longer message goes alone\n"
+	    "\t--streams          every producer sends on a stream of its own, needs sr\n"
+	    "\t--arq=KIND         ARQ strategy, sr (default), gbn or saw as in rdt_sim\n",
+	    prog);
+    exit(-1);
+}
+
+int main(int argc, char *argv[])
+{
+    static struct option long_options[] = {
+	{"loopback", no_argument, NULL, 'r'},
+	{"batch", no_argument, NULL, 'b'},
+	{"seed", required_argument, NULL, 's'},
+	{"loss", required_argument, NULL, 'l'},
+	{"delay", required_argument, NULL, 'd'},
+	{"corrupt", required_argument, NULL, 'c'},
+	{"queue", required_argument, NULL, 'q'},
+	{"streams", no_argument, NULL, 'S'},
+	{"arq", required_argument, NULL, 'a'},
+	{NULL, 0, NULL, 0}
+    };
+
+    const char *loss_spec = "bernoulli:0", *delay_spec = "constant:0.1";
+    unsigned int seed = getpid();
+    bool batch_mode = false;
+    int queue_limit = 16;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", long_options, NULL)) != -1) {
+	switch (opt) {
+	case 'r':
+	    realtime_mode = true;
+	    break;
+	case 'b':
+	    batch_mode = true;
+	    break;
+	case 's':
+	    seed = strtoul(optarg, NULL, 0);
+	    break;
+	case 'l':
+	    loss_spec = optarg;
+	    break;
+	case 'd':
+	    delay_spec = optarg;
+	    break;
+	case 'c':
+	    corrupt_rate = atof(optarg);
+	    if (!is_prob(corrupt_rate)) usage(argv[0]);
+	    break;
+	case 'q':
+	    queue_limit = atoi(optarg);
+	    if (queue_limit<1) usage(argv[0]);
+	    break;
+	case 'S':
+	    use_streams = true;
+	    break;
+	case 'a':
+	    rdt_config.arq = parse_arq(optarg);
+	    if (rdt_config.arq<0) usage(argv[0]);
+	    break;
+	default:
+	    usage(argv[0]);
+	}
+    }
+    if (argc-optind!=3) usage(argv[0]);
+    num_producers = atoi(argv[optind]);
+    num_messages = atoi(argv[optind+1]);
+    msg_size = atoi(argv[optind+2]);
+    if (num_producers<1 || num_producers>(use_streams ? MAX_STREAMS : 256) ||
+	num_messages<0 || msg_size<RECORD_HEADER)
+	usage(argv[0]);
+    if (use_streams && rdt_config.arq!=ARQ_SR) usage(argv[0]);
+
+    sim_init(seed);
+    s2r_channel.loss = make_loss_model(loss_spec);
+    r2s_channel.loss = make_loss_model(loss_spec);
+    s2r_channel.delay = make_delay_model(delay_spec);
+    r2s_channel.delay = make_delay_model(delay_spec);
+    if (s2r_channel.loss==NULL || r2s_channel.loss==NULL ||
+	s2r_channel.delay==NULL || r2s_channel.delay==NULL) {
+	fprintf(stderr, "invalid loss or delay model\n");
+	exit(-1);
+    }
+    if (!sim_prepare()) exit(-1);
+
+    fprintf(stdout, "## %d producers send %d messages of %d bytes each over the %s\n",
+	    num_producers, num_messages, msg_size,
+	    realtime_mode ? "loopback interface" : "simulated channel");
+
+    producers.assign(num_producers, Producer());
+    next_index.assign(num_producers, 0);
+    {
+	Connection conn(queue_limit);
+	for (int i=0; i<num_producers; i++)
+	    conn.spawn(produce(conn, i));
+	if (use_streams)
+	    for (int i=0; i<num_producers; i++)
+		conn.spawn(consume(conn, i, num_messages));
+	else
+	    conn.spawn(consume(conn, 0, (long long) num_producers*num_messages));
+	sim_run(&conn);
+
+	int unfinished = conn.unfinished();
+	if (unfinished>0)
+	    fprintf(stdout, "## %d coroutines had not finished when the run ended\n", unfinished);
+    }
+
+    long long total = (long long) num_producers*num_messages, sent = 0;
+    double total_latency = 0, max_latency = 0;
+    for (int i=0; i<num_producers; i++) {
+	sent += producers[i].sent;
+	total_latency += producers[i].total_latency;
+	if (producers[i].max_latency>max_latency) max_latency = producers[i].max_latency;
+    }
+    bool verified = sent==total && messages_delivered==total && bad_messages==0;
+
+    fprintf(stdout, "\n## Run completed at time %.2fs with\n"
+	    "\t%lld of %lld messages acked, %lld delivered, %lld bad\n"
+	    "\tack latency %.3fs on average, %.3fs at most\n"
+	    "\tat most %lld packets in the send queue\n",
+	    sim_end_time(), sent, total, messages_delivered, bad_messages,
+	    sent>0 ? total_latency/sent : 0.0, max_latency, sender_stats.max_queue_depth);
+    if (verified)
+	fprintf(stdout, "## Every message arrived whole and in order.\n");
+    else
+	fprintf(stdout, "## Something is wrong! Messages are missing or damaged.\n");
+
+    if (batch_mode) {
+	fprintf(stdout, "## Metrics\n"
+		"producers.producers=%d\n"
+		"producers.messages=%lld\n"
+		"producers.acked=%lld\n"
+		"producers.delivered=%lld\n"
+		"producers.bad=%lld\n"
+		"producers.verified=%d\n"
+		"producers.sim_time=%.6f\n"
+		"producers.wall_seconds=%.6f\n"
+		"producers.mean_ack_latency=%.6f\n"
+		"producers.max_ack_latency=%.6f\n"
+		"producers.events=%lld\n"
+		"producers.pkts_passed=%d\n",
+		num_producers, total, sent, messages_delivered, bad_messages, verified ? 1 : 0,
+		sim_end_time(), wall_seconds, sent>0 ? total_latency/sent : 0.0, max_latency,
+		tot_events, tot_pkts_passed);
+	print_protocol_metrics();
+    }
+
+    delete s2r_channel.loss;
+    delete s2r_channel.delay;
+    delete r2s_channel.loss;
+    delete r2s_channel.delay;
+
+    return verified ? 0 : 1;
+}
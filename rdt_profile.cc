@@ -0,0 +1,245 @@
+/*
+ * FILE: rdt_profile.cc
+ * DESCRIPTION: Profiling of the simulator.  Each thread opens its own group
+ *              of counters the first time it enters a region, and keeps a
+ *              stack of the regions it is in.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "rdt_profile.h"
+
+bool profiling = false;
+
+enum {CTR_CYCLES=0, CTR_INSTRUCTIONS, CTR_CACHE_MISSES, NUM_COUNTERS};
+
+/* threads of a run (the partitions of a parallel one), and how deep the
+   regions nest */
+#define MAX_PROFILE_THREADS 4
+#define MAX_PROFILE_DEPTH 32
+
+struct Sample {
+    unsigned long long v[NUM_COUNTERS];
+};
+
+struct RegionStats {
+    long long calls;
+    unsigned long long self[NUM_COUNTERS];  /* outside the inner regions */
+    unsigned long long total[NUM_COUNTERS]; /* including them */
+};
+
+struct Frame {
+    int region;
+    Sample start;
+    Sample inner;           /* counted by the inner regions so far */
+};
+
+struct ProfileThread {
+    bool hardware;          /* perf_event_open() counters, or rdtsc */
+    int leader;             /* fd of the group */
+    int slot[NUM_COUNTERS]; /* place of a counter in the group, -1 if absent */
+    int depth;
+    Frame stack[MAX_PROFILE_DEPTH];
+    RegionStats regions[NUM_PROF_REGIONS];
+};
+
+static ProfileThread threads[MAX_PROFILE_THREADS];
+static std::atomic<int> num_threads(0);
+static thread_local ProfileThread *this_thread = NULL;
+static thread_local bool unprofiled = false;
+
+static const char *region_names[NUM_PROF_REGIONS] = {
+    "event: sender from upper layer",
+    "event: sender from lower layer",
+    "event: sender timeout",
+    "event: receiver from lower layer",
+    "event: receiver upper layer ready",
+    "event chain",
+    "sender timer",
+    "channel",
+    "checksum",
+    "delivery",
+};
+
+
+/*[]------------------------------------------------------------------------[]
+  |  counters
+  []------------------------------------------------------------------------[]*/
+
+/* a counter of the user-space work of this thread, in the group of "group"
+   or leading a new one if it is -1 */
+static int open_counter(unsigned long long config, int group)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+/* the time stamp counter, or nanoseconds where there is none */
+static inline unsigned long long cycle_clock()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static void open_counters(ProfileThread *t)
+{
+    static const unsigned long long configs[NUM_COUNTERS] = {
+	PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES
+    };
+
+    for (int i=0; i<NUM_COUNTERS; i++)
+	t->slot[i] = -1;
+    t->leader = open_counter(configs[CTR_CYCLES], -1);
+    t->hardware = t->leader>=0;
+    if (!t->hardware) return;
+
+    int members = 0;
+    t->slot[CTR_CYCLES] = members++;
+    for (int i=CTR_CYCLES+1; i<NUM_COUNTERS; i++)
+	if (open_counter(configs[i], t->leader)>=0)
+	    t->slot[i] = members++;
+}
+
+static inline void read_sample(ProfileThread *t, Sample *s)
+{
+    if (!t->hardware) {
+	s->v[CTR_CYCLES] = cycle_clock();
+	s->v[CTR_INSTRUCTIONS] = s->v[CTR_CACHE_MISSES] = 0;
+	return;
+    }
+
+    /* the number of counters, then their values in group order */
+    unsigned long long values[1+NUM_COUNTERS];
+    if (read(t->leader, values, sizeof(values))<=0)
+	memset(values, 0, sizeof(values));
+    for (int i=0; i<NUM_COUNTERS; i++)
+	s->v[i] = t->slot[i]>=0 ? values[1+t->slot[i]] : 0;
+}
+
+/* the profile of this thread, NULL if there are more threads than slots */
+static ProfileThread *profile_thread()
+{
+    if (this_thread!=NULL || unprofiled) return this_thread;
+
+    int id = num_threads.fetch_add(1);
+    if (id>=MAX_PROFILE_THREADS) {
+	unprofiled = true;
+	return NULL;
+    }
+    this_thread = &threads[id];
+    open_counters(this_thread);
+    return this_thread;
+}
+
+
+/*[]------------------------------------------------------------------------[]
+  |  regions
+  []------------------------------------------------------------------------[]*/
+
+void profile_enter(int region)
+{
+    ProfileThread *t = profile_thread();
+    if (t==NULL) return;
+    if (t->depth++>=MAX_PROFILE_DEPTH) return;
+
+    Frame *f = &t->stack[t->depth-1];
+    f->region = region;
+    memset(&f->inner, 0, sizeof(f->inner));
+    read_sample(t, &f->start);
+}
+
+void profile_leave()
+{
+    ProfileThread *t = this_thread;
+    if (t==NULL) return;
+    if (--t->depth>=MAX_PROFILE_DEPTH) return;
+
+    Sample now;
+    read_sample(t, &now);
+    Frame *f = &t->stack[t->depth];
+    RegionStats *r = &t->regions[f->region];
+    r->calls++;
+    for (int i=0; i<NUM_COUNTERS; i++) {
+	unsigned long long spent = now.v[i] - f->start.v[i];
+	r->total[i] += spent;
+	r->self[i] += spent - f->inner.v[i];
+	if (t->depth>0)
+	    t->stack[t->depth-1].inner.v[i] += spent;
+    }
+}
+
+void print_profile()
+{
+    int n = num_threads.load();
+    if (n>MAX_PROFILE_THREADS) n = MAX_PROFILE_THREADS;
+
+    RegionStats sum[NUM_PROF_REGIONS];
+    memset(sum, 0, sizeof(sum));
+    bool hardware = n>0, instructions = n>0, misses = n>0;
+    for (int k=0; k<n; k++) {
+	ProfileThread *t = &threads[k];
+	hardware = hardware && t->hardware;
+	instructions = instructions && t->slot[CTR_INSTRUCTIONS]>=0;
+	misses = misses && t->slot[CTR_CACHE_MISSES]>=0;
+	for (int r=0; r<NUM_PROF_REGIONS; r++) {
+	    sum[r].calls += t->regions[r].calls;
+	    for (int i=0; i<NUM_COUNTERS; i++) {
+		sum[r].self[i] += t->regions[r].self[i];
+		sum[r].total[i] += t->regions[r].total[i];
+	    }
+	}
+    }
+
+    unsigned long long all = 0;
+    for (int r=0; r<NUM_PROF_REGIONS; r++)
+	all += sum[r].self[CTR_CYCLES];
+
+    fprintf(stdout, "\n## Profile by region, %s\n"
+	    "## a region is charged what it spends outside the regions it calls (self)\n",
+	    hardware ? "perf_event_open() counters of user-space work" :
+	    "rdtsc cycles only, no hardware counters could be opened");
+    fprintf(stdout, "%-34s %10s %8s %6s %10s %10s %10s %6s %10s\n", "region", "calls",
+	    "Mcycles", "share", "cycles", "incl", "instrs", "IPC", "misses");
+    for (int r=0; r<NUM_PROF_REGIONS; r++) {
+	RegionStats *s = &sum[r];
+	if (s->calls==0) continue;
+	double cycles = s->self[CTR_CYCLES];
+	fprintf(stdout, "%-34s %10lld %8.1f %5.1f%% %10.0f %10.0f", region_names[r], s->calls,
+		cycles/1e6, all ? 100.0*cycles/all : 0.0, cycles/s->calls,
+		(double) s->total[CTR_CYCLES]/s->calls);
+	if (instructions)
+	    fprintf(stdout, " %10.0f %6.2f", (double) s->self[CTR_INSTRUCTIONS]/s->calls,
+		    cycles>0 ? s->self[CTR_INSTRUCTIONS]/cycles : 0.0);
+	else
+	    fprintf(stdout, " %10s %6s", "-", "-");
+	if (misses)
+	    fprintf(stdout, " %10.2f\n", (double) s->self[CTR_CACHE_MISSES]/s->calls);
+	else
+	    fprintf(stdout, " %10s\n", "-");
+    }
+    fprintf(stdout, "%-34s %10s %8.1f %5.1f%%\n"
+	    "## cycles, instrs and misses are per call, incl also counts the regions called\n",
+	    "total", "", all/1e6, 100.0);
+}
@@ -0,0 +1,50 @@
+/*
+ * FILE: rdt_profile.h
+ * DESCRIPTION: Profiling of the simulator (--profile).  Every dispatched
+ *              event and the hot paths inside it run in a profiled region,
+ *              and the cycles, instructions and cache misses of each region
+ *              are counted with perf_event_open(), or only cycles with
+ *              rdtsc when the counters cannot be opened.  Regions nest, a
+ *              region is charged what it spends outside its inner regions.
+ */
+
+
+#ifndef _RDT_PROFILE_H_
+#define _RDT_PROFILE_H_
+
+/* the profiled regions, the event types first */
+enum {PROF_SENDER_FROMUPPERLAYER=0, PROF_SENDER_FROMLOWERLAYER,
+      PROF_SENDER_TIMEOUT, PROF_RECEIVER_FROMLOWERLAYER,
+      PROF_RECEIVER_UPPERLAYERREADY,
+      PROF_CHAIN,               /* scheduling, cancelling, taking events */
+      PROF_TIMER,               /* Sender_StartTimer(), Sender_StopTimer() */
+      PROF_CHANNEL,             /* *_ToLowerLayer(): loss, corruption, delay */
+      PROF_CHECKSUM,            /* building and checking checksums */
+      PROF_DELIVERY,            /* *_ToUpperLayer() and the upper layer */
+      NUM_PROF_REGIONS};
+
+/* set before the run to profile it */
+extern bool profiling;
+
+void profile_enter(int region);
+void profile_leave();
+
+/* the region of a scope, nothing is counted unless profiling */
+class ProfileScope
+{
+private:
+    bool active;
+
+public:
+    ProfileScope(int region) : active(profiling) {
+	if (active) profile_enter(region);
+    }
+    ~ProfileScope() {
+	if (active) profile_leave();
+    }
+};
+
+/* print the breakdown of the run by region */
+void print_profile();
+
+#endif  /* _RDT_PROFILE_H_ */
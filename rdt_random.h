@@ -0,0 +1,47 @@
+/*
+ * FILE: rdt_random.h
+ * DESCRIPTION: The random number generator of the simulator (xoshiro256**).
+ *              Every partition of the simulation draws from its own stream,
+ *              so a sequential and a parallel run of the same seed see the
+ *              same numbers.
+ */
+
+
+#ifndef _RDT_RANDOM_H_
+#define _RDT_RANDOM_H_
+
+struct Random {
+    unsigned long long s[4];
+
+    /* expand a seed into the state with splitmix64 */
+    void seed(unsigned long long x) {
+	for (int i=0; i<4; i++) {
+	    unsigned long long z = (x += 0x9E3779B97F4A7C15ULL);
+	    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	    s[i] = z ^ (z >> 31);
+	}
+    }
+
+    unsigned long long next() {
+	unsigned long long result = rotl(s[1] * 5, 7) * 9;
+	unsigned long long t = s[1] << 17;
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rotl(s[3], 45);
+	return result;
+    }
+
+    /* a number in [0,1] */
+    double uniform() { return (next() >> 11) * (1.0/((1ULL << 53) - 1)); }
+
+private:
+    static unsigned long long rotl(unsigned long long x, int k) {
+	return (x << k) | (x >> (64 - k));
+    }
+};
+
+#endif  /* _RDT_RANDOM_H_ */
@@ -1,16 +1,16 @@
 /*
  * FILE: rdt_receiver.cc
- * DESCRIPTION: Reliable data transfer receiver.
- * NOTE: This implementation assumes there is no packet loss, corruption, or 
- *       reordering.  You will need to enhance it to deal with all these 
- *       situations.  In this implementation, the packet format is laid out as 
- *       the following:
- *       
- *       |<-  1 byte  ->|<-             the rest            ->|
- *       | payload size |<-             payload             ->|
+ * DESCRIPTION: Reliable data transfer receiver, selective repeat.  Packets
+ *              that arrive out of order wait in the receive buffer; those
+ *              next in their stream are delivered without waiting.
+ * NOTE: The packet header is laid out in rdt_header.h, a 2-byte checksum
+ *       ends every packet.  The payload of the packets sent back to the
+ *       sender is
  *
- *       The first byte of each packet indicates the size of the payload
- *       (excluding this single-byte header)
+ *       ack  | next expected seq | free receive buffer | more acked seqs ... |
+ *            the header seq is the first acked seq
+ *       nak  | the missing seqs ... |
+ *            FLAG_NAK, the header seq is the next expected seq
  */
 
 
@@ -20,16 +20,48 @@
 #include "rdt_struct.h"
 #include "rdt_receiver.h"
 #include "rdt_util.h"
+#include "rdt_compress.h"
+#include "rdt_arq.h"
+#include "rdt_checkpoint.h"
 #include <map>
+#include <deque>
 
 std::map<int, packet> buffered_packets;
+std::deque<packet> ready_packets;   // in order, waiting for the upper layer
 int cur_seq_expected = 0;
+int advertised_window = RECV_BUFFER;
+char expanded[COMPRESS_MAX_INPUT];  // the payload of a compressed packet being delivered
 int tot_to = 0;
+double nak_time[MAX_SEQ + 1];   // when each seq was last reported missing
+double hole_time[MAX_SEQ + 1];  // when a packet after each missing seq first arrived, -1 if none
+// a stream packet is delivered as soon as its stream is in order, even with
+// a gap before it in the shared seqs. such a seq is marked early until
+// cur_seq_expected passes it
+bool early[MAX_SEQ + 1];
+unsigned char stream_expected[MAX_STREAMS];    // the next stream seq of each stream
+Receiver_Stats receiver_stats;
 /* receiver initialization, called once at the very beginning */
-void Receiver_Init()
+void sr_receiver_init()
 {
-    fprintf(stdout, "At %.2fs: receiver initializing ...\n", GetSimulationTime());
     cur_seq_expected = 0;
+    advertised_window = RECV_BUFFER;
+    for (int i = 0; i <= MAX_SEQ; ++i) nak_time[i] = -NAK_INTERVAL, hole_time[i] = -1;
+    memset(early, 0, sizeof(early));
+    memset(stream_expected, 0, sizeof(stream_expected));
+}
+
+/* save or restore the receiver's state */
+void sr_receiver_checkpoint(Checkpoint &ck)
+{
+    ck.map(buffered_packets);
+    ck.sequence(ready_packets);
+    ck.value(cur_seq_expected);
+    ck.value(advertised_window);
+    ck.value(tot_to);
+    ck.array(nak_time, MAX_SEQ + 1);
+    ck.array(hole_time, MAX_SEQ + 1);
+    ck.array(early, MAX_SEQ + 1);
+    ck.array(stream_expected, MAX_STREAMS);
 }
 
 /* receiver finalization, called once at the very end.
@@ -39,57 +71,264 @@ void Receiver_Init()
 void Receiver_Final()
 {
     fprintf(stdout, "At %.2fs: receiver finalizing ...\n", GetSimulationTime());
+    fprintf(stdout, "\t%lld packets delivered, %lld buffered out of order, %lld duplicated\n"
+            "\t%lld corrupted, %lld acks sent, %lld naks sent\n"
+            "\t%lld dropped beyond the window, %lld window updates, %lld buffered at most\n"
+            "\t%lld packets decompressed into %lld bytes\n"
+            "\t%lld stream packets delivered ahead of a gap\n",
+            receiver_stats.delivered, receiver_stats.out_of_order, receiver_stats.duplicates,
+            receiver_stats.corrupted, receiver_stats.acks_sent, receiver_stats.naks_sent,
+            receiver_stats.window_drops, receiver_stats.window_updates, receiver_stats.max_buffered,
+            receiver_stats.decompressed, receiver_stats.decompress_out,
+            receiver_stats.early_delivered);
 }
 
+/* whether seq has arrived, buffered or delivered early */
+static bool arrived(int seq)
+{
+    return buffered_packets.count(seq) || early[seq];
+}
 
-/* event handler, called when a packet is passed from the lower layer at the 
-   receiver */
-void Receiver_FromLowerLayer(struct packet *pkt)
+/* seq arrived ahead of cur_seq_expected, report the holes before it to the
+   sender.  a hole only counts as lost once it has stayed open
+   rdt_config.reorder after a later packet arrived, a reordered packet shows
+   up before that.  a
+   hole reported less than NAK_INTERVAL ago is left out, its retransmission
+   may still be on the way */
+static void sendNak(int seq)
 {
-    if (!check_packet(pkt)) { // wrong packet, ignore it
-        DEBUG("[Receiver]Corrupted packet!\n", 2);
-        return ;
-    } else {
-        if (pkt->data[1] == cur_seq_expected) { // right order
-            message *msg = new message;
-            msg->size = pkt->data[0];
-            msg->data = (char*) malloc (msg->size);
-            memcpy(msg->data, pkt->data + HEADER_SIZE, msg->size);
-            Receiver_ToUpperLayer(msg);
-            inc(cur_seq_expected);
-            //cur_seq_expected = (cur_seq_expected + 1) % (MAX_SEQ + 1);
-            DEBUG("[LOWER] got seq = %d, tot_to = %d\n", pkt->data[1], ++tot_to);
-            DEBUG("[RR]Receiver received seq = %d, send ack to sender\n", pkt->data[1]);
-            Receiver_ToLowerLayer(pkt); // ack
-            if (msg->data != NULL) free(msg->data);
-            if (msg != NULL)free(msg);
-        } else {
-            // current turn's packet
-            if (this_turn(pkt->data[1], cur_seq_expected)) {
-                DEBUG("[RR-O]Receiver receive seq = %d, but expect %d, store it and ack\n", pkt->data[1], cur_seq_expected);
-                if (buffered_packets.count(pkt->data[1])) {
-                    DEBUG("****Fatal: buffer overflow seq=%d\n", pkt->data[1]);
-                }
-                buffered_packets[pkt->data[1]] = *pkt;
+    packet nak = packet();
+    char missing[MAX_SEQ + 1];
+    int n = 0;
+    double now = GetSimulationTime();
+    for (int s = cur_seq_expected; s != seq; ) {
+        if (!arrived(s)) {
+            if (hole_time[s] < 0) hole_time[s] = now;
+            if (now - hole_time[s] >= rdt_config.reorder && now - nak_time[s] >= NAK_INTERVAL) {
+                nak_time[s] = now;
+                missing[n++] = (char) s;
             }
-            else {
-                DEBUG("[RR-L]Receiver receive seq = %d, but expect %d, and this may be last turn, only send ack back\n",
-                      pkt->data[1], cur_seq_expected);
+        }
+        inc(s);
+    }
+    if (n == 0) return ;
+    Header h = {FLAG_NAK, cur_seq_expected, n, 0, 0};
+    memcpy(nak.data + encode_header(&nak, &h), missing, n);
+    build_checksum(&nak);
+    DEBUG("[RR-N]Receiver send nak of %d seqs before seq = %d\n", n, seq);
+    Receiver_ToLowerLayer(&nak);
+    receiver_stats.naks_sent++;
+}
+
+
+/* free slots of the receive buffer, the packets from cur_seq_expected on
+   that the receiver can take */
+static int free_slots()
+{
+    return RECV_BUFFER - (int) ready_packets.size();
+}
+
+/* the seq before cur_seq_expected, acking it again only updates the window */
+static int last_in_order()
+{
+    return seq_distance(1, cur_seq_expected);
+}
+
+/* ack seqs[0..n) in one packet, telling the sender the next expected seq and
+   how many packets from there on fit in the receive buffer.  the seqs after
+   the first follow the window in the payload, no seq is listed twice */
+static void sendAcks(const int *seqs, int n)
+{
+    ASSERT(n >= 1 && n <= MAX_SEQ + 1);
+    packet ack = packet();
+    advertised_window = free_slots();
+    Header h = {0, seqs[0], ACK_SIZE + n - 1, 0, 0};
+    int offset = encode_header(&ack, &h);
+    ack.data[offset] = (char) cur_seq_expected;
+    ack.data[offset + 1] = (char) advertised_window;
+    for (int i = 1; i < n; ++i)
+        ack.data[offset + ACK_SIZE + i - 1] = (char) seqs[i];
+    build_checksum(&ack);
+    Receiver_ToLowerLayer(&ack);
+    receiver_stats.acks_sent++;
+}
+
+static void sendAck(int seq)
+{
+    sendAcks(&seq, 1);
+}
+
+/* pass the in-order packets to the upper layer while it keeps up */
+static void deliverReady()
+{
+    while (!ready_packets.empty() && !Receiver_isUpperLayerBusy()) {
+        packet &pkt = ready_packets.front();
+        Header h;
+        message msg;
+        msg.data = pkt.data + decode_header(&pkt, &h);
+        msg.size = h.size;
+        if (h.flags & FLAG_COMPRESSED) {
+            double start = rdt_clock();
+            msg.size = rdt_decompress(msg.data, msg.size, expanded, COMPRESS_MAX_INPUT);
+            msg.data = expanded;
+            receiver_stats.decompress_time += rdt_clock() - start;
+            if (msg.size < 0) { // a corruption the checksum missed
+                msg.size = 0;
+                receiver_stats.corrupted++;
             }
-            Receiver_ToLowerLayer(pkt); // send ack this packet
+            receiver_stats.decompressed++;
+            receiver_stats.decompress_out += msg.size;
         }
-        while (!buffered_packets.empty() && buffered_packets.count(cur_seq_expected)) { // have this
-            packet pkt = buffered_packets[cur_seq_expected];
-            message *msg = new message;
-            msg->size = pkt.data[0];
-            msg->data = (char*) malloc (msg->size);
-            memcpy(msg->data, pkt.data + HEADER_SIZE, msg->size);
-            Receiver_ToUpperLayer(msg);
-            DEBUG("[LOWER] got seq = %d, total to = %d\n", cur_seq_expected, ++tot_to);
-            DEBUG("[RR-B]Receiver from buffer, get seq=%d\n", cur_seq_expected);
-            ASSERT(buffered_packets.erase(cur_seq_expected) > 0);
+        if (msg.size > 0) {
+            if (h.flags & FLAG_STREAM)
+                Receiver_ToUpperLayerOnStream(&msg, h.stream);
+            else
+                Receiver_ToUpperLayer(&msg);
+        }
+        receiver_stats.delivered++;
+        ready_packets.pop_front();
+    }
+}
+
+/* whether a packet is the next one of its stream */
+static bool streamInOrder(packet *pkt)
+{
+    Header h;
+    decode_header(pkt, &h);
+    return (h.flags & FLAG_STREAM) && h.stream_seq == stream_expected[h.stream];
+}
+
+/* a packet goes to the upper layer, its stream moves on */
+static void readyPacket(packet *pkt)
+{
+    ready_packets.push_back(*pkt);
+    Header h;
+    decode_header(pkt, &h);
+    if (h.flags & FLAG_STREAM) stream_expected[h.stream]++;
+}
+
+/* the packets buffered behind a gap in the shared seqs that are next in
+   their streams need not wait for the gap */
+static void releaseStreams()
+{
+    bool released = true;
+    while (released) {
+        released = false;
+        for (auto it = buffered_packets.begin(); it != buffered_packets.end(); ++it) {
+            if (!streamInOrder(&it->second)) continue;
+            DEBUG("[RR-S]Receiver delivers seq = %d early\n", it->first);
+            readyPacket(&it->second);
+            early[it->first] = true;
+            receiver_stats.early_delivered++;
+            buffered_packets.erase(it);
+            released = true;
+            break;
+        }
+    }
+}
+
+
+/* take a data packet that passed check_packet() into the receive buffer,
+   return the seq to ack for it */
+static int takePacket(packet *pkt)
+{
+    int seq = packet_seq(pkt);
+    hole_time[seq] = -1;
+    if ((seq == cur_seq_expected || this_turn(seq, cur_seq_expected))
+        && seq_distance(cur_seq_expected, seq) >= free_slots()) {
+        // the upper layer is behind, no room for it. the ack of the last
+        // in-order packet tells the sender the current window
+        DEBUG("[RR-W]Receiver receive seq = %d, but the window is %d, drop it\n", seq, free_slots());
+        receiver_stats.window_drops++;
+        return last_in_order();
+    }
+    if (seq == cur_seq_expected) { // right order
+        readyPacket(pkt);
+        inc(cur_seq_expected);
+        //cur_seq_expected = (cur_seq_expected + 1) % (MAX_SEQ + 1);
+        DEBUG("[LOWER] got seq = %d, tot_to = %d\n", seq, ++tot_to);
+        DEBUG("[RR]Receiver received seq = %d, send ack to sender\n", seq);
+    } else {
+        // current turn's packet
+        if (this_turn(seq, cur_seq_expected)) {
+            DEBUG("[RR-O]Receiver receive seq = %d, but expect %d, store it and ack\n", seq, cur_seq_expected);
+            if (buffered_packets.count(seq) || early[seq]) {
+                DEBUG("****Fatal: buffer overflow seq=%d\n", seq);
+                receiver_stats.duplicates++;
+            } else {
+                receiver_stats.out_of_order++;
+                if (rdt_config.nak) sendNak(seq);
+            }
+            if (!early[seq]) buffered_packets[seq] = *pkt;
+        }
+        else {
+            DEBUG("[RR-L]Receiver receive seq = %d, but expect %d, and this may be last turn, only send ack back\n",
+                  seq, cur_seq_expected);
+            receiver_stats.duplicates++;
+        }
+    }
+    long long buffered = buffered_packets.size() + ready_packets.size();
+    if (buffered > receiver_stats.max_buffered) receiver_stats.max_buffered = buffered;
+    releaseStreams();
+    for (;;) { // have this
+        if (early[cur_seq_expected]) { // delivered already
+            early[cur_seq_expected] = false;
             inc(cur_seq_expected);
-            //Receiver_ToLowerLayer(&pkt); // ack
+            continue;
         }
+        if (!buffered_packets.count(cur_seq_expected)) break;
+        readyPacket(&buffered_packets[cur_seq_expected]);
+        DEBUG("[LOWER] got seq = %d, total to = %d\n", cur_seq_expected, ++tot_to);
+        DEBUG("[RR-B]Receiver from buffer, get seq=%d\n", cur_seq_expected);
+        ASSERT(buffered_packets.erase(cur_seq_expected) > 0);
+        inc(cur_seq_expected);
+        releaseStreams();
+    }
+    return seq;
+}
+
+/* event handler, called when a packet is passed from the lower layer at the 
+   receiver */
+void sr_receiver_from_lower(struct packet *pkt)
+{
+    if (!check_packet(pkt) || (pkt->data[FLAGS_BYTE] & FLAG_NAK)) { // wrong packet, ignore it
+        DEBUG("[Receiver]Corrupted packet!\n", 2);
+        receiver_stats.corrupted++;
+        return ;
+    }
+    int seq = takePacket(pkt);
+    deliverReady();
+    sendAck(seq);
+}
+
+/* the packets that arrived together are taken one by one, and one ack
+   lists the seqs of all of them */
+void sr_receiver_from_lower_batch(struct packet **pkts, int n)
+{
+    bool ok[MAX_BATCH];
+    int seqs[MAX_SEQ + 1], acks = 0;  // distinct, however many packets arrived
+    check_packets(pkts, n, ok);
+    for (int i = 0; i < n; ++i) {
+        if (!ok[i] || (pkts[i]->data[FLAGS_BYTE] & FLAG_NAK)) {
+            receiver_stats.corrupted++;
+            continue;
+        }
+        int seq = takePacket(pkts[i]), j = 0;
+        deliverReady(); // frees the buffer for the next one
+        while (j < acks && seqs[j] != seq) j++;
+        if (j == acks) seqs[acks++] = seq;
+    }
+    if (acks > 0) sendAcks(seqs, acks);
+}
+
+/* event handler, called when the upper layer at the receiver is ready for
+   the next message */
+void sr_receiver_upper_ready()
+{
+    deliverReady();
+    if (advertised_window == 0 && free_slots() > 0) { // the sender may be waiting for this
+        DEBUG("[RR-U]Receiver window reopened to %d\n", free_slots());
+        receiver_stats.window_updates++;
+        sendAck(last_in_order());
     }
 }
@@ -10,6 +10,8 @@
 
 #include "rdt_struct.h"
 
+class Checkpoint;
+
 
 /*[]------------------------------------------------------------------------[]
   |  routines that you can call
@@ -24,6 +26,14 @@ void Receiver_ToLowerLayer(struct packet *pkt);
 /* deliver a message to the upper layer at the receiver */
 void Receiver_ToUpperLayer(struct message *msg);
 
+/* deliver a message of the given stream to the upper layer at the receiver,
+   Receiver_ToUpperLayer() delivers to stream 0 */
+void Receiver_ToUpperLayerOnStream(struct message *msg, int stream);
+
+/* check whether the upper layer at the receiver is still busy with the last
+   message, Receiver_UpperLayerReady() will be called when it is done */
+bool Receiver_isUpperLayerBusy();
+
 
 /*[]------------------------------------------------------------------------[]
   |  routines to be changed/enhanced by you
@@ -39,8 +49,21 @@ void Receiver_Init();
    memory you allocated in Receiver_init(). */
 void Receiver_Final();
 
+/* save the state of the receiver into a checkpoint of the simulation, or
+   restore it from one after Receiver_Init() */
+void Receiver_Checkpoint(Checkpoint &ck);
+
 /* event handler, called when a packet is passed from the lower layer at the 
    receiver */
 void Receiver_FromLowerLayer(struct packet *pkt);
 
+/* event handler, called with the n packets (at most MAX_BATCH of rdt_util.h)
+   passed from the lower layer at the receiver at the same time, in the order
+   they arrived */
+void Receiver_FromLowerLayerBatch(struct packet **pkts, int n);
+
+/* event handler, called when the upper layer at the receiver is ready for
+   the next message */
+void Receiver_UpperLayerReady();
+
 #endif  /* _RDT_RECEIVER_H_ */
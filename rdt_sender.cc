@@ -1,16 +1,16 @@
 /*
  * FILE: rdt_sender.cc
- * DESCRIPTION: Reliable data transfer sender.
- * NOTE: This implementation assumes there is no packet loss, corruption, or 
- *       reordering.  You will need to enhance it to deal with all these 
- *       situations.  In this implementation, the packet format is laid out as 
- *       the following:
- *       
- *       |<-  1 byte  ->|<-             the rest            ->|
- *       | payload size |<-             payload             ->|
+ * DESCRIPTION: Reliable data transfer sender, selective repeat.  Lost and
+ *              corrupted packets are resent when their logical clock expires
+ *              or the receiver NAKs them.
+ * NOTE: The packet header is laid out in rdt_header.h, a 2-byte checksum
+ *       ends every packet.  The payload of the packets the receiver sends
+ *       back is
  *
- *       The first byte of each packet indicates the size of the payload
- *       (excluding this single-byte header)
+ *       ack  | next expected seq | free receive buffer | more acked seqs ... |
+ *            the header seq is the first acked seq
+ *       nak  | the missing seqs ... |
+ *            FLAG_NAK, the header seq is the receiver's next expected seq
  */
 
 
@@ -23,6 +23,9 @@
 #include "rdt_struct.h"
 #include "rdt_sender.h"
 #include "rdt_util.h"
+#include "rdt_compress.h"
+#include "rdt_arq.h"
+#include "rdt_checkpoint.h"
 
 int tot_from = 0;
 int next_frame_to_send, ack_expected, buffered_num;
@@ -32,10 +35,25 @@ bool clock_set[MAX_SEQ + 1];
 //std::map<double, Time_pair> logical_clock;
 packet buffers[MAX_SEQ + 1];
 bool buffered_ack[MAX_SEQ + 1];
+double send_time[MAX_SEQ + 1];  // first transmission of the packet in buffers[]
+double last_sent[MAX_SEQ + 1];  // its latest transmission
+bool resent[MAX_SEQ + 1];
+// flow control counts packets from the start: new packets sent, packets acked
+// in order, and the end of the receiver's advertised window
+long long sent_count, acked_count, window_edge;
+int probe_seq = -1;             // a packet sent into a closed window, not acked yet
+// packets are waiting on the full window, or on the receiver's window
+bool window_stalled, rwnd_stalled;
+int cur_stream = -1;            // the stream of the message being packetized, -1 for none
+unsigned char stream_seq[MAX_STREAMS];  // the next stream seq of each stream
+Sender_Stats sender_stats;
 
 void resendPacket(int seq);
 bool push_to_buffer(packet &packet) {
     packets.push(packet);
+    sender_stats.queued++;
+    if (++sender_stats.queue_depth > sender_stats.max_queue_depth)
+        sender_stats.max_queue_depth = sender_stats.queue_depth;
     return true;
 }
 
@@ -43,6 +61,7 @@ bool pop_from_buffer(packet *pPacket) {
     if (packets.empty()) return false;
     *pPacket = packets.front();
     packets.pop();
+    sender_stats.queue_depth--;
     return true;
 }
 
@@ -68,6 +87,7 @@ void Update_clock() {
             DEBUG("Clock seq = %d, create_time = %f expired\n", seq, (*logical_clock.begin()).create_time);
             clock_set[seq] = false;
             resend_list.emplace_back(seq);
+            sender_stats.timeout_resent++;
             logical_clock.erase(logical_clock.begin());
         } else {
             Sender_StartTimer(lastTime);
@@ -100,32 +120,147 @@ void Wrapped_StopTimer(int seq) {
 }
 
 // try to send a packet, if buffered_num >= 10, directly return
-// this will be called everywhere
-void try_sendPacket() {
+// this will be called everywhere. return whether a packet was sent
+bool try_sendPacket() {
     //if (GetSimulationTime() > 20) abort();
-    if (buffered_num >= MAX_WINDOW) return; // inque number, waiting for ack ...
+    // a stall is counted once, when the sender gets stuck on it
+    bool stalled = buffered_num >= MAX_WINDOW && !packets.empty();
+    if (stalled && !window_stalled) sender_stats.window_stalls++;
+    window_stalled = stalled;
+    stalled = buffered_num < MAX_WINDOW && !packets.empty() && sent_count >= window_edge && buffered_num > 0;
+    if (stalled && !rwnd_stalled) sender_stats.rwnd_stalls++;
+    rwnd_stalled = stalled;
+    if (buffered_num >= MAX_WINDOW) { // inque number, waiting for ack ...
+        return false;
+    }
+    if (packets.empty()) return false;
+    if (sent_count >= window_edge) { // the receiver has no room
+        if (buffered_num > 0) { // their acks will bring the window
+            return false;
+        }
+        // nothing in flight, probe the closed window with the next packet,
+        // its clock repeats the probe until the receiver takes it
+        DEBUG("[S-W]Receiver window closed, probe with seq = %d\n", ack_expected);
+        sender_stats.window_probes++;
+        probe_seq = ack_expected;
+    }
     packet pkt;
-    if (!pop_from_buffer(&pkt)) return;
-    ASSERT(pkt.data[1] <= MAX_SEQ);
-    buffers[(int)pkt.data[1]] = pkt;
+    pop_from_buffer(&pkt);
+    sender_stats.first_sent++;
+    sent_count++;
+    int seq = packet_seq(&pkt);
+    buffers[seq] = pkt;
+    send_time[seq] = last_sent[seq] = GetSimulationTime();
+    resent[seq] = false;
     buffered_num++;
-    Wrapped_StartTimer(pkt.data[1]);
+    Wrapped_StartTimer(seq);
     Sender_ToLowerLayer(&pkt);
-    DEBUG("Sent a packet, seq = %d\n", pkt.data[1]);
+    DEBUG("Sent a packet, seq = %d\n", seq);
+    return true;
 }
 void resendPacket(int seq) {
     packet pkt = buffers[seq];
+    resent[seq] = true;
+    last_sent[seq] = GetSimulationTime();
     Wrapped_StartTimer(seq);
     Sender_ToLowerLayer(&pkt);
     DEBUG("Resent a packet, seq = %d\n", seq);
 }
 
+// the first ack of a packet, account how long a lost one took to recover
+void packetAcked(int seq) {
+    sender_stats.acks_received++;
+    if (seq == probe_seq) probe_seq = -1;
+    if (resent[seq]) {
+        sender_stats.recovered++;
+        sender_stats.recovery_time += GetSimulationTime() - send_time[seq];
+    }
+}
+
+// every ack carries the receiver's next expected seq and its free buffer
+// slots from there on, move the edge of the window the receiver allows
+void updateWindow(packet *pkt) {
+    Header h;
+    int offset = decode_header(pkt, &h);
+    if (h.size < ACK_SIZE) return;
+    int expected = pkt->data[offset], window = pkt->data[offset + 1];
+    if (expected < 0 || expected > MAX_SEQ || window < 0 || window > RECV_BUFFER) return;
+    int acked = seq_distance(ack_expected, expected);
+    if (acked > buffered_num) return; // an ack from an earlier turn
+    // the receiver's buffer only ever frees up, so the edge never moves back
+    // and a reordered old ack cannot close the window again
+    if (acked_count + acked + window > window_edge)
+        window_edge = acked_count + acked + window;
+    if (probe_seq >= 0 && clock_set[probe_seq] && !buffered_ack[probe_seq]
+        && acked_count + seq_distance(ack_expected, probe_seq) < window_edge) {
+        // the window reopened over the probe, no need to wait for its clock
+        sender_stats.fast_resent++;
+        Wrapped_StopTimer(probe_seq);
+        resendPacket(probe_seq);
+        probe_seq = -1;
+    }
+}
+
+// the receiver reports the sequence numbers in the payload as missing,
+// resend those still waiting for an ack without waiting for their clocks.
+// a nak sent before the last ack that moved the window is stale, its
+// seqs may already belong to the next turn.  every extra copy on the way
+// may also outlive a turn of the seqs, so a packet sent less than
+// rdt_config.reorder ago, still possibly on the way, is left to its clock
+void handleNak(packet *pkt) {
+    sender_stats.naks_received++;
+    Header h;
+    int offset = decode_header(pkt, &h);
+    if (h.seq != ack_expected) return;
+    for (int i = 0; i < h.size; ++i) {
+        int seq = pkt->data[offset + i];
+        if (seq < 0 || seq > MAX_SEQ) continue;
+        if (seq_distance(ack_expected, seq) >= buffered_num) continue; // not in flight
+        if (GetSimulationTime() - last_sent[seq] < rdt_config.reorder) continue; // may be reordered only
+        if (!clock_set[seq] || buffered_ack[seq]) continue; // acked, or not sent yet
+        DEBUG("[S-NAK]Sender received nak, resend seq = %d\n", seq);
+        sender_stats.fast_resent++;
+        Wrapped_StopTimer(seq); // restart its clock from the retransmission
+        resendPacket(seq);
+    }
+}
+
+/* selective repeat, reached through the Sender_* entry points in rdt_arq.cc */
+
 /* sender initialization, called once at the very beginning */
-void Sender_Init() {
-    fprintf(stdout, "At %.2fs: sender initializing ...\n", GetSimulationTime());
+void sr_sender_init() {
     next_frame_to_send = 0;
     ack_expected = 0;
     buffered_num = 0;
+    sent_count = acked_count = 0;
+    window_edge = RECV_BUFFER;
+    probe_seq = -1;
+    window_stalled = rwnd_stalled = false;
+    cur_stream = -1;
+    memset(stream_seq, 0, sizeof(stream_seq));
+}
+
+/* save or restore the sender's state */
+void sr_sender_checkpoint(Checkpoint &ck) {
+    ck.value(tot_from);
+    ck.value(next_frame_to_send);
+    ck.value(ack_expected);
+    ck.value(buffered_num);
+    ck.queue(packets);
+    ck.sequence(logical_clock);
+    ck.array(clock_set, MAX_SEQ + 1);
+    ck.array(buffers, MAX_SEQ + 1);
+    ck.array(buffered_ack, MAX_SEQ + 1);
+    ck.array(send_time, MAX_SEQ + 1);
+    ck.array(last_sent, MAX_SEQ + 1);
+    ck.array(resent, MAX_SEQ + 1);
+    ck.value(sent_count);
+    ck.value(acked_count);
+    ck.value(window_edge);
+    ck.value(probe_seq);
+    ck.value(window_stalled);
+    ck.value(rwnd_stalled);
+    ck.array(stream_seq, MAX_STREAMS);
 }
 
 /* sender finalization, called once at the very end.
@@ -134,81 +269,205 @@ void Sender_Init() {
    memory you allocated in Sender_init(). */
 void Sender_Final() {
     fprintf(stdout, "At %.2fs: sender finalizing ...\n", GetSimulationTime());
+    fprintf(stdout, "\t%lld packets sent, %lld resent on timeout, %lld resent early\n"
+            "\t%lld acks received, %lld ignored, %lld duplicated, %lld corrupted\n"
+            "\t%lld window-full stalls, send queue depth %lld (max %lld)\n"
+            "\t%lld receiver-window stalls, %lld window probes\n"
+            "\t%lld naks received, %lld packets recovered in %.3fs on average\n"
+            "\t%lld packets compressed, %lld bytes into %lld\n",
+            sender_stats.first_sent, sender_stats.timeout_resent, sender_stats.fast_resent,
+            sender_stats.acks_received, sender_stats.acks_ignored, sender_stats.acks_duplicate,
+            sender_stats.corrupted, sender_stats.window_stalls, sender_stats.queue_depth,
+            sender_stats.max_queue_depth, sender_stats.rwnd_stalls, sender_stats.window_probes,
+            sender_stats.naks_received, sender_stats.recovered,
+            sender_stats.recovered ? sender_stats.recovery_time / sender_stats.recovered : 0.0,
+            sender_stats.compressed, sender_stats.compress_in, sender_stats.compress_out);
 }
 
-/* event handler, called when a message is passed from the upper layer at the 
-   sender */
-void Sender_FromUpperLayer(struct message *msg) {
-    int header_size = HEADER_SIZE;
-    int maxpayload_size = MAX_PAYLOAD;
+/* the header of the next data packet of the current message, on its stream
+   if it has one.  the caller sets the payload size */
+static Header nextHeader() {
+    Header h;
+    h.flags = cur_stream < 0 ? 0 : FLAG_STREAM;
+    h.seq = next_frame_to_send;
+    h.size = 0;
+    h.stream = cur_stream < 0 ? 0 : cur_stream;
+    h.stream_seq = cur_stream < 0 ? 0 : stream_seq[cur_stream];
+    return h;
+}
+
+/* write the header into the packet, its seq and stream seq are used up.
+   return where the payload goes */
+static int writeHeader(packet &pkt, const Header &h) {
+    int offset = encode_header(&pkt, &h);
+    inc(next_frame_to_send);
+    if (cur_stream >= 0) stream_seq[cur_stream]++;
+    return offset;
+}
+
+/* packetize a message with every packet filled by as much of it as compresses
+   into the payload.  once a packet does not carry more than a raw one would,
+   the rest of the message is sent raw */
+void sendCompressed(struct message *msg) {
+    bool compressible = true;
     int cursor = 0;
-    packet pkt;
-    while (msg->size - cursor > maxpayload_size) {
-        pkt.data[0] = (char)(maxpayload_size & 0XFF);
-        pkt.data[1] = (char)(next_frame_to_send & 0XFF);
-        inc(next_frame_to_send);
-        memcpy(pkt.data + HEADER_SIZE, msg->data + cursor, maxpayload_size);
-        build_checksum(&pkt);
-        if (!push_to_buffer(pkt)) {
-            DEBUG("Fatal: buffer used up, seq = %d\n", next_frame_to_send);
+    char payload[MAX_PAYLOAD];
+    packet pkt = packet(); // a corrupted length must not reach stack garbage
+    while (cursor < msg->size) {
+        int remaining = msg->size - cursor;
+        Header h = nextHeader();
+        int capacity = payload_capacity(&h), raw = payload_room(&h, remaining);
+        int used = 0, size = 0;
+        // a message that fits in one packet cannot save a packet
+        if (compressible && remaining > capacity) {
+            double start = rdt_clock();
+            // leave room for the length field, the output may fall short of a full packet
+            size = rdt_compress(msg->data + cursor, remaining, payload, capacity - varint_size(capacity), &used);
+            sender_stats.compress_time += rdt_clock() - start;
+            compressible = used > raw;
+        } else
+            compressible = false;
+        if (compressible) {
+            h.flags |= FLAG_COMPRESSED;
+            h.size = size;
+            memcpy(pkt.data + writeHeader(pkt, h), payload, size);
+            sender_stats.compressed++;
+            sender_stats.compress_in += used;
+            sender_stats.compress_out += size;
+        } else {
+            used = raw;
+            h.size = raw;
+            memcpy(pkt.data + writeHeader(pkt, h), msg->data + cursor, raw);
         }
-        DEBUG("[UPPER]: got seq = %d, total = %d\n", pkt.data[1], ++tot_from);
-        cursor += maxpayload_size;
+        build_checksum(&pkt);
+        push_to_buffer(pkt);
+        cursor += used;
         try_sendPacket();
     }
-    if (msg->size > cursor) {
-        pkt.data[0] = (char)((msg->size - cursor) & 0XFF);
-        pkt.data[1] = (char)(next_frame_to_send & 0XFF);
-        inc(next_frame_to_send);
-        memcpy(pkt.data + HEADER_SIZE, msg->data + cursor, msg->size - cursor);
+}
+
+/* event handler, called when a message is passed from the upper layer at the 
+   sender */
+void sr_sender_from_upper(struct message *msg) {
+    if (rdt_config.compress) {
+        sendCompressed(msg);
+        return ;
+    }
+    int cursor = 0;
+    packet pkt = packet();
+    // full packets, then the rest of the message with a length field
+    while (cursor < msg->size) {
+        Header h = nextHeader();
+        h.size = payload_room(&h, msg->size - cursor);
+        memcpy(pkt.data + writeHeader(pkt, h), msg->data + cursor, h.size);
         build_checksum(&pkt);
-        DEBUG("[UPPER]: got seq = %d, total = %d\n", pkt.data[1], ++tot_from);
         if (!push_to_buffer(pkt)) {
             DEBUG("Fatal: buffer used up, seq = %d\n", next_frame_to_send);
         }
+        DEBUG("[UPPER]: got seq = %d, total = %d\n", h.seq, ++tot_from);
+        cursor += h.size;
         try_sendPacket();
     }
     try_sendPacket();
 }
 
-/* event handler, called when a packet is passed from the lower layer at the 
-   sender
-   This is always ack in my implementation
-   */
-void Sender_FromLowerLayer(struct packet *pkt) {
-    if (!check_packet(pkt)) {
-        DEBUG("[Sender]Corrupted packet!\n", 1);
-        return ;
-    }
-    if (ack_expected == pkt->data[1]) { // success to receive ack
+/* a message on a stream: its packets carry the stream header, and the
+   receiver keeps them in order within the stream only */
+void sr_sender_from_upper_stream(struct message *msg, int stream) {
+    cur_stream = stream;
+    sr_sender_from_upper(msg);
+    cur_stream = -1;
+}
+
+/* the receiver acked seq */
+void ackSeq(int seq) {
+    if (ack_expected == seq) { // success to receive ack
         Wrapped_StopTimer(ack_expected);
+        packetAcked(ack_expected);
         buffered_num--;
+        acked_count++;
+        sender_stats.acked++;
         inc(ack_expected);
-        DEBUG("[S-ACK]Sender received ack, seq = %d, is expected\n", pkt->data[1]);
+        DEBUG("[S-ACK]Sender received ack, seq = %d, is expected\n", seq);
     } else { // another packet's ack, just stop the timer
-        if (this_turn(pkt->data[1], ack_expected)) {
-            DEBUG("[S-O]Sender received ack, seq = %d, not expected, store it\n", pkt->data[1]);
-            if (buffered_ack[pkt->data[1]]) {
-                DEBUG("FATAL: *** buffered_ack overwritted, seq = %d\n", pkt->data[1]);
-            }
-            buffered_ack[pkt->data[1]] = true;
+        if (this_turn(seq, ack_expected)) {
+            DEBUG("[S-O]Sender received ack, seq = %d, not expected, store it\n", seq);
+            if (buffered_ack[seq]) {
+                DEBUG("FATAL: *** buffered_ack overwritted, seq = %d\n", seq);
+                sender_stats.acks_duplicate++;
+            } else
+                packetAcked(seq);
+            buffered_ack[seq] = true;
         }
-        else
-            DEBUG("[S-L]Sender received ack, seq = %d, not expected and too old, ignore it\n", pkt->data[1]);
-        Wrapped_StopTimer(pkt->data[1]); // even it's old, should stop timer
+        else {
+            DEBUG("[S-L]Sender received ack, seq = %d, not expected and too old, ignore it\n", seq);
+            sender_stats.acks_ignored++;
+        }
+        Wrapped_StopTimer(seq); // even it's old, should stop timer
     }
     while (buffered_ack[ack_expected]) {
         buffered_num--;
+        acked_count++;
+        sender_stats.acked++;
         DEBUG("[S-B]Sender get ack from buffer, seq %d\n", ack_expected);
         buffered_ack[ack_expected] = false;
         inc(ack_expected);
     }
+}
+
+/* an ack or a nak that passed check_packet(), new packets are left to the
+   caller.  a coalesced ack lists more acked seqs after the window */
+void handleAck(packet *pkt) {
+    if (pkt->data[FLAGS_BYTE] & FLAG_NAK) {
+        handleNak(pkt);
+        return ;
+    }
+    if (pkt->data[FLAGS_BYTE] & (FLAG_COMPRESSED | FLAG_STREAM)) { // never on an ack
+        sender_stats.corrupted++;
+        return ;
+    }
+    updateWindow(pkt);
+    Header h;
+    int offset = decode_header(pkt, &h);
+    ackSeq(h.seq);
+    for (int i = offset + ACK_SIZE; i < offset + h.size; ++i)
+        if (pkt->data[i] >= 0 && pkt->data[i] <= MAX_SEQ) ackSeq(pkt->data[i]);
+}
+
+/* event handler, called when a packet is passed from the lower layer at the 
+   sender
+   This is an ack, or a nak when the receiver runs in nak mode
+   */
+void sr_sender_from_lower(struct packet *pkt) {
+    if (!check_packet(pkt)) {
+        DEBUG("[Sender]Corrupted packet!\n", 1);
+        sender_stats.corrupted++;
+        return ;
+    }
+    handleAck(pkt);
     try_sendPacket();
 }
 
+/* the acks that arrived together are taken first, then as many packets go
+   out as they would have released one by one */
+void sr_sender_from_lower_batch(struct packet **pkts, int n) {
+    bool ok[MAX_BATCH];
+    int taken = 0;
+    check_packets(pkts, n, ok);
+    for (int i = 0; i < n; ++i) {
+        if (!ok[i]) {
+            sender_stats.corrupted++;
+            continue;
+        }
+        handleAck(pkts[i]);
+        taken++;
+    }
+    while (taken-- > 0 && try_sendPacket()) ;
+}
+
 /* event handler, called when the timer expires */
 /* simply resend all datas in buffer*/
-void Sender_Timeout() {
+void sr_sender_timeout() {
     DEBUG("Timeout, logical_clock is %d, seq = %d, update_clock\n", (*logical_clock.begin()).seq, ack_expected);
     Update_clock();
 }
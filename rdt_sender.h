@@ -10,6 +10,8 @@
 
 #include "rdt_struct.h"
 
+class Checkpoint;
+
 
 /*[]------------------------------------------------------------------------[]
   |  routines that you can call
@@ -53,10 +55,25 @@ void Sender_Final();
    sender */
 void Sender_FromUpperLayer(struct message *msg);
 
+/* event handler, called when a message on the given stream (below
+   MAX_STREAMS of rdt_util.h) is passed from the upper layer at the sender.
+   messages are delivered in order within their stream only, a loss on one
+   stream does not hold up the others */
+void Sender_FromUpperLayerOnStream(struct message *msg, int stream);
+
+/* save the state of the sender into a checkpoint of the simulation, or
+   restore it from one after Sender_Init() */
+void Sender_Checkpoint(Checkpoint &ck);
+
 /* event handler, called when a packet is passed from the lower layer at the 
    sender */
 void Sender_FromLowerLayer(struct packet *pkt);
 
+/* event handler, called with the n packets (at most MAX_BATCH of rdt_util.h)
+   passed from the lower layer at the sender at the same time, in the order
+   they arrived */
+void Sender_FromLowerLayerBatch(struct packet **pkts, int n);
+
 /* event handler, called when the timer expires */
 void Sender_Timeout();
 
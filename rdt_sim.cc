@@ -11,122 +11,23 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <vector>
+#include <utility>
 
 #include "rdt_struct.h"
 #include "rdt_sender.h"
 #include "rdt_receiver.h"
-
-
-/*[]------------------------------------------------------------------------[]
-  |  generic event chain framework
-  []------------------------------------------------------------------------[]*/
-
-/* simulation event base class */
-class Event
-{
-public:
-    double sched_time;      /* scheduled occuring time */
-    int event_type;         /* application-specific event type */
-    class Event *next;      /* next event in the chain */
-
-public:
-    Event() { next = NULL; }
-};
-
-/* event chain class - the simulation core */
-class EventChain
-{
-public:
-    double sim_time;        /* simulation time */
-    Event *head;            /* head event in the chain */
-
-public:
-    EventChain() {
-	sim_time = 0;
-	head = NULL;
-    }
-    
-    double time() { return sim_time; }
-    
-    /* schedule an event - the event chain is maintained on an increasing order 
-       of sched_time */
-    void schedule(Event *e) {
-	/* do nothing if the event is schedule for the past */
-	if (e->sched_time<sim_time) return;
-
-	Event **ppcur = &head;
-	while ((*ppcur!=NULL) && ((*ppcur)->sched_time<=e->sched_time))
-	    ppcur = &((*ppcur)->next);
-
-	e->next = *ppcur;
-	*ppcur = e;
-    }
-
-    /* cancel an event scheduled for happening in the future */
-    void cancel(Event *e) {
-	Event **ppcur = &head;
-	while ((*ppcur!=NULL) && (*ppcur!=e))
-	    ppcur = &((*ppcur)->next);
-
-	if (*ppcur==e) *ppcur=(*ppcur)->next;
-    }
-
-    /* advance to the next event */
-    Event *next_event() {
-	if (head==NULL) return NULL;
-
-	Event *e = head;
-	head = head->next;
-	sim_time = e->sched_time;
-
-	return e;
-    }
-};
-
-
-/*[]------------------------------------------------------------------------[]
-  |  event definitions
-  []------------------------------------------------------------------------[]*/
-
-enum {EVENT_SENDER_FROMUPPERLAYER=0, EVENT_SENDER_FROMLOWERLAYER, 
-      EVENT_SENDER_TIMEOUT, EVENT_RECEIVER_FROMLOWERLAYER};
-
-/* the event that the upper layer at the sender instructs rdt layer to send out 
-   a message */
-class EventSenderFromUpperLayer : public Event
-{
-public:
-    EventSenderFromUpperLayer() { event_type = EVENT_SENDER_FROMUPPERLAYER; }
-};
-
-/* the event that the lower layer at the sender informs the rdt layer that a 
-   packet is received from the link */
-class EventSenderFromLowerLayer : public Event
-{
-public:
-    struct packet pkt;
-public:
-    EventSenderFromLowerLayer() { event_type = EVENT_SENDER_FROMLOWERLAYER; }
-};
-
-/* the event that the timer at the sender expires */
-class EventSenderTimeout : public Event
-{
-public:
-    EventSenderTimeout() { event_type = EVENT_SENDER_TIMEOUT; }
-};
-
-/* the event that the lower layer at the receiver informs the rdt layer that a 
-   packet is received from the link */
-class EventReceiverFromLowerLayer : public Event
-{
-public:
-    struct packet pkt;
-public:
-    EventReceiverFromLowerLayer() { event_type = EVENT_RECEIVER_FROMLOWERLAYER; }
-};
+#include "rdt_util.h"
+#include "rdt_arq.h"
+#include "rdt_channel.h"
+#include "rdt_workload.h"
+#include "rdt_random.h"
+#include "rdt_simcore.h"
+#include "rdt_checkpoint.h"
+#include "rdt_profile.h"
 
 
 /*[]------------------------------------------------------------------------[]
@@ -155,196 +56,226 @@ double outoforder_rate;
    lost on average */
 double loss_rate;
 
-/* packet corruption probability: a value of 0.1 means that one in ten packets
-   (excluding those lost) are corrupted on average.  note that any part of the 
-   packet can be corrupted */
-double corrupt_rate;
+/* channel models of the sender->receiver and receiver->sender directions, 
+   by default independent loss at "loss_rate" and the normal latency with 
+   reordering at "outoforder_rate" (see rdt_simcore.h for the channels) */
+const char *s2r_loss_spec = NULL, *r2s_loss_spec = NULL;
+const char *s2r_delay_spec = NULL, *r2s_delay_spec = NULL;
+
+/* the upper layer at the sender, by default the original generator with 
+   "msg_arrivalint" and "msg_size" */
+Workload *workload = NULL;
+const char *workload_spec = "uniform";
+
+/* payload pattern of the generated messages, verified at the receiver */
+Pattern payload_pattern(Pattern::DIGITS);
+
+/* the upper layers spread the messages over the streams round robin, each
+   stream a byte stream of its own with its own payload pattern.  the sender
+   logs where each message ends in its stream and when it was generated, the
+   receiver where each delivery ends and when; the two logs give the latency
+   of every message after the run, without the two sides sharing anything */
+struct Stream {
+    Pattern pattern;
+    long long sent, delivered;	/* bytes */
+    std::vector<std::pair<long long, double> > sends, deliveries;
+    long long messages;		/* delivered in full */
+    double total_latency, max_latency;
+
+    Stream(Pattern::Kind kind) : pattern(kind), sent(0), delivered(0), messages(0),
+	total_latency(0), max_latency(0) {}
+};
+int num_streams = 1;
+std::vector<Stream> streams;
 
-/* tracing levels (higher level always prints out more information):
-   a tracing level of 0 turns off all traces while a tracing, 
-   a tracing level of 1 turns on regular traces,
-   a tracing level of 2 prints out the delivered message
-*/
-int tracing_level;
+/* buffers of the generated messages */
+MessagePool msg_pool;
 
-/* simulation event chain core */
-EventChain sim_core;
+/* batch mode: do not wait for <enter>, and dump the final metrics as 
+   key=value lines that scripts can parse */
+bool batch_mode = false;
 
-/* sender timer event */
-Event *sender_timer = NULL;
+/* seed of the random number generator, fixed with --seed for reproducible 
+   runs */
+unsigned int rand_seed;
 
 /* general statistics */
 int tot_chars_sent = 0;
 int tot_chars_delivered = 0;
-int tot_pkts_passed = 0;
 
 /* error flag set by message verification at the receiver */
 bool message_verfication_passed = true;
 
+/* offset in the delivered byte stream of the first byte that failed the 
+   verification, -1 if none did */
+long long first_mismatch_offset = -1;
+
 
 /*[]------------------------------------------------------------------------[]
-  |  simulation routines
+  |  the upper layers: message generator and verification
   []------------------------------------------------------------------------[]*/
 
-/* generate a random number in [0,1] */
-static double myrandom()
-{
-    return(rand()*1.0/RAND_MAX);
-}
-
 /* generate a message 
    NOTE: change this part if you want to generate different messages for 
          testing.  we will certainly use different messages in our grading! */
-static struct message *generate_msg()
+static struct message *generate_msg(Stream &stream)
 {
-    static char cnt = 0;
-
-    struct message *msg = (struct message*) malloc(sizeof(struct message));
-    ASSERT(msg!=NULL);
-    msg->size = (int)(myrandom()*2.0*msg_size);
-    if (msg->size==0) msg->size=1;
-    msg->data = (char*) malloc(msg->size);
-    ASSERT(msg->data!=NULL);
-
-    for (int i=0; i<msg->size; i+=1) {
-	msg->data[i] = '0' + cnt;
-	cnt = (cnt+1) % 10;
-    }
+    struct message *msg = msg_pool.get(workload->size());
+    stream.pattern.fill(msg->data, msg->size);
 
     tot_chars_sent += msg->size;
+    if (msg->size>0) {
+	stream.sent += msg->size;
+	stream.sends.push_back(std::make_pair(stream.sent, GetSimulationTime()));
+    }
 
     return msg;
 }
 
-/* free the space of a message */
+/* return the space of a message to the pool */
 static void free_msg(struct message *msg)
 {
-    if (msg->data!=NULL) free(msg->data);
-    if (msg!=NULL) free(msg);
+    msg_pool.put(msg);
 }
 
-/* get simulation time (in seconds) - for both the sender and the receiver */
-double GetSimulationTime()
+class Generator : public Application
 {
-    return sim_core.time();
-}
+    int next_stream;
 
-/* start the sender timer with a specified timeout (in seconds).
-   the timer is cancelled with Sender_StopTimer() is called or a new 
-   Sender_StartTimer() is called before the current timer expires.
-   Sender_Timeout() will be called when the timer expires. */
-void Sender_StartTimer(double timeout)
-{
-    if (tracing_level>=1)
-	fprintf(stdout, "Time %.2fs (Sender): the timer is started (expires at %.2fs).\n",
-		sim_core.time(), sim_core.time() + timeout);
-
-    if (sender_timer!=NULL) {
-	sim_core.cancel(sender_timer);
-	delete sender_timer;
-	sender_timer = NULL;
+public:
+    Generator() : next_stream(0) {}
+
+    double first_arrival() { return workload->first_arrival(); }
+
+    double send_next() {
+	int s = next_stream;
+	next_stream = (next_stream+1) % num_streams;
+	struct message *msg = generate_msg(streams[s]);
+	if (num_streams>1)
+	    Sender_FromUpperLayerOnStream(msg, s);
+	else
+	    Sender_FromUpperLayer(msg);
+	free_msg(msg);
+	return GetSimulationTime() < sim_time ? workload->interval() : -1;
     }
 
-    EventSenderTimeout *e = new EventSenderTimeout;
-    e->sched_time = sim_core.time() + timeout;
-    sim_core.schedule(e);
-
-    sender_timer = e;
-}
+    /* message verification, within the stream of the message
+       NOTE: change the message verification here if you changed 
+             generate_msg() for testing. */
+    void deliver(struct message *msg, int stream) {
+	if (stream<0 || stream>=num_streams) {
+	    message_verfication_passed = false;
+	    return;
+	}
+	Stream &st = streams[stream];
+	long long mismatch = st.pattern.verify(msg->data, msg->size);
+	if (mismatch >= 0 && message_verfication_passed) {
+	    message_verfication_passed = false;
+	    first_mismatch_offset = mismatch;
+	}
 
-/* stop the sender timer */
-void Sender_StopTimer()
-{
-    if (tracing_level>=1)
-	fprintf(stdout, "Time %.2fs (Sender): the timer is stopped.\n", 
-		sim_core.time());
-
-    if (sender_timer!=NULL) {
-	sim_core.cancel(sender_timer);
-	delete sender_timer;
-	sender_timer = NULL;
+	tot_chars_delivered += msg->size;
+	st.delivered += msg->size;
+	st.deliveries.push_back(std::make_pair(st.delivered, GetSimulationTime()));
     }
-}
-
-/* check whether the sender timer is being set,
-   return true if the timer is set, return false otherwise */
-bool Sender_isTimerSet()
-{
-    return (sender_timer!=NULL);
-}
-
-/* pass a packet to the lower layer at the sender */
-void Sender_ToLowerLayer(struct packet *pkt)
-{
-    /* packet lost at rate "loss_rate" */
-    if (myrandom()<loss_rate) return;
 
-    EventReceiverFromLowerLayer *e = new EventReceiverFromLowerLayer;
-    memcpy(&e->pkt.data, pkt->data, RDT_PKTSIZE);
-
-    /* packet corrupted at rate "corrupt_rate" */
-    if (myrandom()<corrupt_rate) {
-	for (int i=0; i<RDT_PKTSIZE; i++) {
-	    e->pkt.data[i] = e->pkt.data[i] + (char)(myrandom()*20) - 10;
+    /* the streams and what was sent and verified on them so far, and the
+       workload.  the streams and the pattern must be the ones the
+       checkpoint was taken with */
+    void checkpoint(Checkpoint &ck) {
+	ck.expect(num_streams);
+	ck.expect(payload_pattern.kind);
+	ck.value(next_stream);
+	for (int s=0; s<num_streams; s++) {
+	    Stream &st = streams[s];
+	    ck.value(st.pattern.fill_offset);
+	    ck.value(st.pattern.verify_offset);
+	    ck.value(st.sent);
+	    ck.value(st.delivered);
+	    ck.sequence(st.sends);
+	    ck.sequence(st.deliveries);
 	}
+	ck.value(tot_chars_sent);
+	ck.value(tot_chars_delivered);
+	ck.value(message_verfication_passed);
+	ck.value(first_mismatch_offset);
+	ck.model(workload);
     }
+};
 
-    /* schedule the packet arrival event at the other side */
-    if (myrandom()<outoforder_rate)
-	e->sched_time = sim_core.time() + pkt_latency*2.0*myrandom();
-    else
-	e->sched_time = sim_core.time() + pkt_latency;
-    sim_core.schedule(e);
-
-    tot_pkts_passed ++;
-}
-
-
-/* pass a packet to the lower layer at the receiver */
-void Receiver_ToLowerLayer(struct packet *pkt)
+/* match the sends of each stream with the delivery of their last byte */
+static void account_latency()
 {
-    /* packet lost at rate "loss_rate" */
-    if (myrandom()<loss_rate) return;
-
-    EventSenderFromLowerLayer *e = new EventSenderFromLowerLayer;
-    memcpy(&e->pkt.data, pkt->data, RDT_PKTSIZE);
-
-    /* packet corrupted at rate "corrupt_rate" */
-    if (myrandom()<corrupt_rate) {
-	for (int i=0; i<RDT_PKTSIZE; i++) {
-	    e->pkt.data[i] = e->pkt.data[i] + (char)(myrandom()*20) - 10;
+    for (int s=0; s<num_streams; s++) {
+	Stream &st = streams[s];
+	size_t d = 0;
+	for (size_t i=0; i<st.sends.size(); i++) {
+	    while (d<st.deliveries.size() && st.deliveries[d].first<st.sends[i].first)
+		d++;
+	    if (d==st.deliveries.size()) break;
+	    double latency = st.deliveries[d].second - st.sends[i].second;
+	    st.messages++;
+	    st.total_latency += latency;
+	    if (latency>st.max_latency) st.max_latency = latency;
 	}
     }
-
-    /* schedule the packet arrival event at the other side */
-    if (myrandom()<outoforder_rate)
-	e->sched_time = sim_core.time() + pkt_latency*2.0*myrandom();
-    else
-	e->sched_time = sim_core.time() + pkt_latency;	
-    sim_core.schedule(e);
-
-    tot_pkts_passed ++;
 }
 
-/* deliver a message to the upper layer at the receiver 
-   NOTE: change the message verification in this function if you changed 
-         generate_msg() for testing. */
-void Receiver_ToUpperLayer(struct message *msg)
+/* latency over all the streams */
+static void total_latency(long long *messages, double *mean, double *max)
 {
-    static char cnt = 0;
-
-    for (int i=0; i<msg->size; i++) {
-	/* message verification */
-	if (msg->data[i] != '0' + cnt) {
-	    message_verfication_passed = false;
-	}
-	cnt = (cnt+1) % 10;
-
-	if (tracing_level>=2)
-	    fputc(msg->data[i], stdout);
+    double total = 0.0;
+    *messages = 0;
+    *max = 0.0;
+    for (int s=0; s<num_streams; s++) {
+	*messages += streams[s].messages;
+	total += streams[s].total_latency;
+	if (streams[s].max_latency>*max) *max = streams[s].max_latency;
     }
+    *mean = *messages>0 ? total/ *messages : 0.0;
+}
 
-    tot_chars_delivered += msg->size;
+
+/* dump every counter of the run, one key=value pair per line */
+static void print_metrics()
+{
+    long long messages;
+    double mean_latency, max_latency;
+    total_latency(&messages, &mean_latency, &max_latency);
+    fprintf(stdout, "## Metrics\n"
+	    "sim.time=%.6f\n"
+	    "sim.chars_sent=%d\n"
+	    "sim.chars_delivered=%d\n"
+	    "sim.pkts_passed=%d\n"
+	    "sim.verified=%d\n"
+	    "sim.first_mismatch=%lld\n"
+	    "sim.seed=%u\n"
+	    "sim.events=%lld\n"
+	    "sim.wall_seconds=%.6f\n"
+	    "sim.events_per_sec=%.0f\n"
+	    "sim.bytes_per_sec=%.0f\n"
+	    "sim.batches=%lld\n"
+	    "sim.mean_batch=%.3f\n"
+	    "sim.streams=%d\n"
+	    "sim.messages=%lld\n"
+	    "sim.mean_latency=%.6f\n"
+	    "sim.max_latency=%.6f\n",
+	    sim_end_time(), tot_chars_sent, tot_chars_delivered, tot_pkts_passed,
+	    (message_verfication_passed && tot_chars_sent==tot_chars_delivered) ? 1 : 0,
+	    first_mismatch_offset, rand_seed, tot_events, wall_seconds, 
+	    wall_seconds>0 ? tot_events/wall_seconds : 0.0,
+	    wall_seconds>0 ? tot_chars_delivered/wall_seconds : 0.0,
+	    tot_batches, tot_batches>0 ? (double) tot_batched/tot_batches : 0.0,
+	    num_streams, messages, mean_latency, max_latency);
+    if (num_streams>1)
+	for (int s=0; s<num_streams; s++)
+	    fprintf(stdout, "stream.%d.messages=%lld\n"
+		    "stream.%d.mean_latency=%.6f\n"
+		    "stream.%d.max_latency=%.6f\n",
+		    s, streams[s].messages,
+		    s, streams[s].messages>0 ? streams[s].total_latency/streams[s].messages : 0.0,
+		    s, streams[s].max_latency);
+    print_protocol_metrics();
 }
 
 
@@ -352,14 +283,152 @@ void Receiver_ToUpperLayer(struct message *msg)
   |  main simulation control routine
   []------------------------------------------------------------------------[]*/
 
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [options] <sim_time> <mean_msg_arrivalint> <mean_msg_size> "
+	    "<outoforder_rate> <loss_rate> <corrupt_rate> <tracing_level>\n"
+	    "options:\n"
+	    "\t--batch            run without prompting and print key=value metrics\n"
+	    "\t--seed=N           seed the random number generator with N\n"
+	    "\t--loss=SPEC        loss model of both directions (also --s2r-loss, --r2s-loss):\n"
+	    "\t                   bernoulli:<p>, ge:<p_gb>,<p_bg>[,<loss_good>[,<loss_bad>]]\n"
+	    "\t--delay=SPEC       delay model of both directions (also --s2r-delay, --r2s-delay):\n"
+	    "\t                   reorder:<latency>,<rate>, constant:<d>, uniform:<lo>,<hi>,\n"
+	    "\t                   pareto:<base>,<scale>,<alpha>, trace:<file>\n"
+	    "\t--workload=SPEC    upper layer at the sender: uniform, bimodal:<small>,<large>,<p_large>,\n"
+	    "\t                   pareto:<min_size>,<alpha>[,<max_size>], onoff:<on_mean>,<off_mean>,\n"
+	    "\t                   trace:<file>\n"
+	    "\t--pattern=KIND     payload pattern, digits or random\n"
+	    "\t--parallel         run the sender and the receiver sides on their own threads\n"
+	    "\t--batch-dispatch   hand packets arriving at the same time to the rdt layer together\n"
+	    "\t--nak              the receiver reports gaps with NAKs instead of waiting for timeouts\n"
+	    "\t--consume=T        the upper layer at the receiver takes T seconds per message\n"
+	    "\t--compress         compress the payload of messages that shrink\n"
+	    "\t--arq=KIND         ARQ strategy: sr (selective repeat, default), gbn (go-back-N)\n"
+	    "\t                   or saw (stop-and-wait), --nak and --compress need sr\n"
+	    "\t--streams=N        spread the messages over N independently ordered streams, needs sr\n"
+	    "\t--checkpoint=T:FILE  save the state of the run to FILE once the events up to time T\n"
+	    "\t                   have run, and go on\n"
+	    "\t--restore=FILE     continue the run saved in FILE, with the same ARQ strategy, streams\n"
+	    "\t                   and pattern; the other settings may differ for what-if runs\n"
+	    "\t--profile          count the cycles, instructions and cache misses of each event type\n"
+	    "\t                   and hot path, and print the breakdown\n",
+	    prog);
+    exit(-1);
+}
+
 int main(int argc, char *argv[])
 {
-    if (argc!=8) {
-	fprintf(stderr, "usage: %s <sim_time> <mean_msg_arrivalint> <mean_msg_size> "
-		"<outoforder_rate> <loss_rate> <corrupt_rate> <tracing_level>\n", 
-		argv[0]);
-	exit(-1);
+    static struct option long_options[] = {
+	{"batch", no_argument, NULL, 'b'},
+	{"seed", required_argument, NULL, 's'},
+	{"loss", required_argument, NULL, 'l'},
+	{"s2r-loss", required_argument, NULL, 'L'},
+	{"r2s-loss", required_argument, NULL, 'M'},
+	{"delay", required_argument, NULL, 'd'},
+	{"s2r-delay", required_argument, NULL, 'D'},
+	{"r2s-delay", required_argument, NULL, 'E'},
+	{"workload", required_argument, NULL, 'w'},
+	{"pattern", required_argument, NULL, 'p'},
+	{"parallel", no_argument, NULL, 'P'},
+	{"batch-dispatch", no_argument, NULL, 'B'},
+	{"nak", no_argument, NULL, 'n'},
+	{"consume", required_argument, NULL, 'c'},
+	{"compress", no_argument, NULL, 'z'},
+	{"arq", required_argument, NULL, 'a'},
+	{"streams", required_argument, NULL, 'S'},
+	{"checkpoint", required_argument, NULL, 'C'},
+	{"restore", required_argument, NULL, 'R'},
+	{"profile", no_argument, NULL, 'f'},
+	{NULL, 0, NULL, 0}
+    };
+
+    rand_seed = getpid()+getppid();
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", long_options, NULL)) != -1) {
+	switch (opt) {
+	case 'b':
+	    batch_mode = true;
+	    break;
+	case 's':
+	    rand_seed = strtoul(optarg, NULL, 0);
+	    break;
+	case 'l':
+	    s2r_loss_spec = r2s_loss_spec = optarg;
+	    break;
+	case 'L':
+	    s2r_loss_spec = optarg;
+	    break;
+	case 'M':
+	    r2s_loss_spec = optarg;
+	    break;
+	case 'd':
+	    s2r_delay_spec = r2s_delay_spec = optarg;
+	    break;
+	case 'D':
+	    s2r_delay_spec = optarg;
+	    break;
+	case 'E':
+	    r2s_delay_spec = optarg;
+	    break;
+	case 'w':
+	    workload_spec = optarg;
+	    break;
+	case 'p':
+	    if (strcmp(optarg, "digits")==0)
+		payload_pattern.kind = Pattern::DIGITS;
+	    else if (strcmp(optarg, "random")==0)
+		payload_pattern.kind = Pattern::RANDOM;
+	    else
+		usage(argv[0]);
+	    break;
+	case 'P':
+	    parallel_mode = true;
+	    break;
+	case 'B':
+	    batch_dispatch = true;
+	    break;
+	case 'n':
+	    rdt_config.nak = true;
+	    break;
+	case 'c':
+	    consume_time = atof(optarg);
+	    if (consume_time<0) usage(argv[0]);
+	    break;
+	case 'z':
+	    rdt_config.compress = true;
+	    break;
+	case 'a':
+	    rdt_config.arq = parse_arq(optarg);
+	    if (rdt_config.arq<0) usage(argv[0]);
+	    break;
+	case 'S':
+	    num_streams = atoi(optarg);
+	    if (num_streams<1 || num_streams>MAX_STREAMS) usage(argv[0]);
+	    break;
+	case 'C':
+	    {
+		char *end;
+		checkpoint_time = strtod(optarg, &end);
+		if (end==optarg || *end!=':' || end[1]=='\0' || checkpoint_time<0) usage(argv[0]);
+		checkpoint_path = end+1;
+	    }
+	    break;
+	case 'R':
+	    restore_path = optarg;
+	    break;
+	case 'f':
+	    profiling = true;
+	    break;
+	default:
+	    usage(argv[0]);
+	}
     }
+    if (argc-optind!=7) usage(argv[0]);
+    if (rdt_config.arq!=ARQ_SR && (rdt_config.nak || rdt_config.compress || num_streams>1))
+	usage(argv[0]);
+    argv += optind-1;
 
     sim_time = atof(argv[1]);
     if (sim_time<=0) {
@@ -396,6 +465,30 @@ int main(int argc, char *argv[])
 	fprintf(stderr, "invalid <tracing_level>\n");
 	exit(-1);
     }
+
+    sim_init(rand_seed);
+
+    s2r_channel.loss = s2r_loss_spec ? make_loss_model(s2r_loss_spec) : new BernoulliLoss(loss_rate);
+    r2s_channel.loss = r2s_loss_spec ? make_loss_model(r2s_loss_spec) : new BernoulliLoss(loss_rate);
+    if (s2r_channel.loss==NULL || r2s_channel.loss==NULL) {
+	fprintf(stderr, "invalid loss model\n");
+	exit(-1);
+    }
+    s2r_channel.delay = s2r_delay_spec ? make_delay_model(s2r_delay_spec) 
+				       : new ReorderDelay(pkt_latency, outoforder_rate);
+    r2s_channel.delay = r2s_delay_spec ? make_delay_model(r2s_delay_spec) 
+				       : new ReorderDelay(pkt_latency, outoforder_rate);
+    if (s2r_channel.delay==NULL || r2s_channel.delay==NULL) {
+	fprintf(stderr, "invalid delay model\n");
+	exit(-1);
+    }
+    workload = make_workload(workload_spec, msg_arrivalint, msg_size);
+    if (workload==NULL) {
+	fprintf(stderr, "invalid workload\n");
+	exit(-1);
+    }
+
+    if (!sim_prepare()) exit(-1);
     
     fprintf(stdout, "## Reliable data transfer simulation with:\n"
 	    "\tsimulation time is %.3f seconds\n"
@@ -404,19 +497,37 @@ int main(int argc, char *argv[])
 	    "\taverage out-of-order delivery rate is %.2f%%\n"
 	    "\taverage loss rate is %.2f%%\n"
 	    "\taverage corrupt rate is %.2f%%\n"
-	    "\ttracing level is %d\n"
-	    "Please review these inputs and press <enter> to proceed.\n",
+	    "\ttracing level is %d\n",
 	    sim_time, msg_arrivalint, msg_size, outoforder_rate*100.0, 
 	    loss_rate*100.0, corrupt_rate*100.0, tracing_level);
-    fgetc(stdin);
-
-    /* initialize the random number generator */
-    srand(getpid()+getppid());
+    if (s2r_loss_spec || s2r_delay_spec)
+	fprintf(stdout, "\tsender->receiver channel: loss %s, delay %s\n",
+		s2r_loss_spec ? s2r_loss_spec : "default", 
+		s2r_delay_spec ? s2r_delay_spec : "default");
+    if (r2s_loss_spec || r2s_delay_spec)
+	fprintf(stdout, "\treceiver->sender channel: loss %s, delay %s\n",
+		r2s_loss_spec ? r2s_loss_spec : "default", 
+		r2s_delay_spec ? r2s_delay_spec : "default");
+    if (strcmp(workload_spec, "uniform")!=0 || payload_pattern.kind!=Pattern::DIGITS)
+	fprintf(stdout, "\tworkload is %s with the %s payload pattern\n", workload_spec,
+		payload_pattern.kind==Pattern::DIGITS ? "digits" : "random");
+    if (rdt_config.arq!=ARQ_SR)
+	fprintf(stdout, "\tARQ strategy is %s\n", arq_name(rdt_config.arq));
+    if (num_streams>1)
+	fprintf(stdout, "\tmessages are spread over %d streams\n", num_streams);
+    if (restore_path)
+	fprintf(stdout, "\tcontinuing from the checkpoint %s\n", restore_path);
+    if (!batch_mode) {
+	fprintf(stdout, "Please review these inputs and press <enter> to proceed.\n");
+	fgetc(stdin);
+    }
 
     /* test the random number generator */
+    Random randtest;
+    randtest.seed(rand_seed);
     double randtest_sum = 0.0;
     for (int i=0; i<1000; i++)
-	randtest_sum += myrandom();
+	randtest_sum += randtest.uniform();
     double randtest_avg = randtest_sum/1000;
     if (randtest_avg<0.25 || randtest_avg>0.75) {
 	fprintf(stderr, 
@@ -426,107 +537,43 @@ int main(int argc, char *argv[])
 	exit(-1);
     }
 
-    /* intialize the sender and the receiver */
-    Sender_Init();
-    Receiver_Init();
-
-    /* scheduling a recurring message arrival event */
-    EventSenderFromUpperLayer *e = new EventSenderFromUpperLayer;
-    e->sched_time = 0;
-    sim_core.schedule(e);
-
-    /* main simulation cycle */
-    for (;;) {
-	Event *e = sim_core.next_event();
-	if (e==NULL) break;
-
-	switch (e->event_type) {
-	case EVENT_SENDER_FROMUPPERLAYER:
-	    {
-		if (tracing_level>=1) {
-		    fprintf(stdout, "Time %.2fs (Sender): the upper layer instructs rdt layer to send out a message.\n", sim_core.time());
-		}
-
-		EventSenderFromUpperLayer *real_e = (EventSenderFromUpperLayer*) e;
-
-		struct message *msg = generate_msg();
-		Sender_FromUpperLayer(msg);
-		free_msg(msg);
-
-		/* schedule the recurring event */
-		if (sim_core.time() < sim_time) {
-		    real_e->sched_time = 
-			sim_core.time() + msg_arrivalint*2.0*myrandom();
-		    sim_core.schedule(real_e);
-		}
-		else
-		    delete real_e;
-	    }
-	    break;
-
-	case EVENT_SENDER_FROMLOWERLAYER:
-	    {
-		if (tracing_level>=1) {
-		    fprintf(stdout, "Time %.2fs (Sender): the lower layer informs the rdt layer that a packet is received from the link.\n", sim_core.time());
-		}
-
-		EventSenderFromLowerLayer *real_e = (EventSenderFromLowerLayer*) e;
-
-		Sender_FromLowerLayer(&real_e->pkt);
-
-		delete real_e;
-	    }
-	    break;
-
-	case EVENT_SENDER_TIMEOUT:
-	    {
-		if (tracing_level>=1) {
-		    fprintf(stdout, "Time %.2fs (Sender): the timer expires.\n", sim_core.time());
-		}
-
-		EventSenderTimeout *real_e = (EventSenderTimeout*) e;
-		delete real_e;
-		sender_timer = NULL;
-
-		Sender_Timeout();
-	    }
-	    break;
-
-	case EVENT_RECEIVER_FROMLOWERLAYER:
-	    {
-		if (tracing_level>=1) {
-		    fprintf(stdout, "Time %.2fs (Receiver): the lower layer informs the rdt layer that a packet is received from the link.\n", sim_core.time());
-		}
+    for (int s=0; s<num_streams; s++)
+	streams.push_back(Stream(payload_pattern.kind));
 
-		EventReceiverFromLowerLayer *real_e = (EventReceiverFromLowerLayer*) e;
-		
-		Receiver_FromLowerLayer(&real_e->pkt);
+    Generator generator;
+    sim_run(&generator);
+    account_latency();
 
-		delete real_e;
-	    }
-	    break;
-
-	default:
-	    fprintf(stderr, "undefined event %d\n", e->event_type);
-	    break;
-	}
-    }
-
-    /* finalize the sender and the receiver */
-    Sender_Final();
-    Receiver_Final();
+    delete s2r_channel.loss;
+    delete s2r_channel.delay;
+    delete r2s_channel.loss;
+    delete r2s_channel.delay;
+    delete workload;
 
     fprintf(stdout, "\n");
     fprintf(stdout, "## Simulation completed at time %.2fs with\n" 
 	    "\t%d characters sent\n" 
 	    "\t%d characters delivered\n"
 	    "\t%d packets passed between the sender and the receiver\n", 
-	    sim_core.time(), tot_chars_sent, tot_chars_delivered, tot_pkts_passed);
+	    sim_end_time(), tot_chars_sent, tot_chars_delivered, tot_pkts_passed);
+    if (num_streams>1)
+	for (int s=0; s<num_streams; s++)
+	    fprintf(stdout, "\tstream %d: %lld messages, latency %.3fs on average, %.3fs at most\n",
+		    s, streams[s].messages,
+		    streams[s].messages>0 ? streams[s].total_latency/streams[s].messages : 0.0,
+		    streams[s].max_latency);
 
     if (message_verfication_passed && (tot_chars_sent==tot_chars_delivered))
 	fprintf(stdout, "## Congratulations! This session is error-free, loss-free, and in order.\n");
-    else
+    else {
 	fprintf(stdout, "## Something is wrong! This session is NOT error-free, loss-free, and in order.\n");
+	if (first_mismatch_offset >= 0)
+	    fprintf(stdout, "## The first corrupted or misordered character is at offset %lld.\n",
+		    first_mismatch_offset);
+    }
+
+    if (profiling) print_profile();
+    if (batch_mode) print_metrics();
 
     return 0;
 }
@@ -0,0 +1,1003 @@
+/*
+ * FILE: rdt_simcore.cc
+ * DESCRIPTION: The simulation core: the events, the engines that run them, 
+ *              the channels between the sender and the receiver, and the 
+ *              routines the rdt layer calls.  The upper layers are supplied 
+ *              by the program as an Application, the message generator of 
+ *              rdt_sim or the file transfer of rdt_xfer.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <poll.h>
+#include <thread>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "rdt_struct.h"
+#include "rdt_sender.h"
+#include "rdt_receiver.h"
+#include "rdt_util.h"
+#include "rdt_event.h"
+#include "rdt_channel.h"
+#include "rdt_random.h"
+#include "rdt_simcore.h"
+#include "rdt_checkpoint.h"
+#include "rdt_profile.h"
+
+/*[]------------------------------------------------------------------------[]
+  |  event definitions
+  []------------------------------------------------------------------------[]*/
+
+enum {EVENT_SENDER_FROMUPPERLAYER=0, EVENT_SENDER_FROMLOWERLAYER, 
+      EVENT_SENDER_TIMEOUT, EVENT_RECEIVER_FROMLOWERLAYER, 
+      EVENT_RECEIVER_UPPERLAYERREADY};
+
+/* an event is dispatched in the profiled region of the same number */
+static_assert((int) EVENT_RECEIVER_UPPERLAYERREADY==(int) PROF_RECEIVER_UPPERLAYERREADY, 
+	      "the events and their profiled regions are out of step");
+
+/* the event that the upper layer at the sender instructs rdt layer to send out 
+   a message */
+class EventSenderFromUpperLayer : public Event
+{
+public:
+    EventSenderFromUpperLayer() { event_type = EVENT_SENDER_FROMUPPERLAYER; }
+};
+
+/* the event that the lower layer at the sender informs the rdt layer that a 
+   packet is received from the link */
+class EventSenderFromLowerLayer : public Event
+{
+public:
+    struct packet pkt;
+public:
+    EventSenderFromLowerLayer() { event_type = EVENT_SENDER_FROMLOWERLAYER; }
+};
+
+/* the event that the timer at the sender expires */
+class EventSenderTimeout : public Event
+{
+public:
+    EventSenderTimeout() { event_type = EVENT_SENDER_TIMEOUT; }
+};
+
+/* the event that the lower layer at the receiver informs the rdt layer that a 
+   packet is received from the link */
+class EventReceiverFromLowerLayer : public Event
+{
+public:
+    struct packet pkt;
+public:
+    EventReceiverFromLowerLayer() { event_type = EVENT_RECEIVER_FROMLOWERLAYER; }
+};
+
+/* the event that the upper layer at the receiver is done with the last 
+   message */
+class EventReceiverUpperLayerReady : public Event
+{
+public:
+    EventReceiverUpperLayerReady() { event_type = EVENT_RECEIVER_UPPERLAYERREADY; }
+};
+
+
+/*[]------------------------------------------------------------------------[]
+  |  gloabal variables, statistics, etc.
+  []------------------------------------------------------------------------[]*/
+
+/* packet corruption probability: a value of 0.1 means that one in ten packets
+   (excluding those lost) are corrupted on average.  note that any part of the 
+   packet can be corrupted */
+double corrupt_rate;
+
+/* channel models of the sender->receiver and receiver->sender directions */
+Channel s2r_channel, r2s_channel;
+
+/* time the upper layer at the receiver spends on each message (in seconds), 
+   0 means it takes messages as fast as they come */
+double consume_time = 0;
+bool receiver_upper_busy = false;
+
+/* tracing levels (higher level always prints out more information):
+   a tracing level of 0 turns off all traces while a tracing, 
+   a tracing level of 1 turns on regular traces,
+   a tracing level of 2 prints out the delivered message
+*/
+int tracing_level;
+
+/* the simulation is split in two partitions, the sender side and the 
+   receiver side, which only interact through packets on the link.  a 
+   sequential run keeps the events of both in one chain; a parallel run gives 
+   each its own chain and thread, and passes packets through mailboxes */
+enum {PART_SENDER=0, PART_RECEIVER, NUM_PARTS};
+
+struct Partition {
+    int id;
+    EventChain *chain;      /* where the events of the partition are kept */
+    Mailbox inbox;          /* events scheduled by the other partition */
+    Random rng;             /* random stream of the partition */
+    long long scheduled;    /* events scheduled by the partition so far */
+    double sent;            /* earliest event put in the other inbox this round, -1 if none */
+    long long events;       /* events dispatched */
+    long long batches;      /* packet arrivals handed over together */
+    long long batched;      /* packets in them */
+    int pkts_passed;
+};
+
+/* simulation event chain core */
+EventChain sim_core;
+
+/* the chain of the receiver partition in a parallel run */
+EventChain receiver_core;
+
+Partition partitions[NUM_PARTS];
+
+/* the partition running on this thread */
+static thread_local Partition *cur_part;
+
+/* run the partitions in parallel (--parallel), the minimum link latency is 
+   their lookahead */
+bool parallel_mode = false;
+double lookahead = 0;
+
+/* hand packets arriving at one side at the same time to the rdt layer in 
+   one *_FromLowerLayerBatch() call (--batch-dispatch) */
+bool batch_dispatch = false;
+
+/* checkpoints of the run (--checkpoint, --restore) */
+const char *checkpoint_path = NULL;
+double checkpoint_time = 0;
+const char *restore_path = NULL;
+
+#define CHECKPOINT_MAGIC 0x31544b5043544452ULL  /* "RDTCKPT1" */
+
+/* run in real time over UDP sockets on the loopback interface instead of 
+   the delay models, one socket for each side */
+bool realtime_mode = false;
+static int sender_fd = -1, receiver_fd = -1;
+
+/* sender timer event */
+Event *sender_timer = NULL;
+
+/* general statistics */
+int tot_pkts_passed = 0;
+long long tot_events = 0;
+long long tot_batches = 0, tot_batched = 0;
+double wall_seconds = 0;
+
+/* the upper layers of the running simulation */
+static Application *app = NULL;
+
+
+/*[]------------------------------------------------------------------------[]
+  |  simulation routines
+  []------------------------------------------------------------------------[]*/
+
+/* wall clock (in seconds), used to report the simulator's own speed */
+double wall_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+/* generate a random number in [0,1], from the stream of the running 
+   partition */
+double myrandom()
+{
+    return cur_part->rng.uniform();
+}
+
+/* the event chain of the running partition */
+static EventChain *local_core()
+{
+    return cur_part->chain;
+}
+
+/* the partition an event belongs to */
+static int event_partition(int event_type)
+{
+    return (event_type==EVENT_RECEIVER_FROMLOWERLAYER || 
+	    event_type==EVENT_RECEIVER_UPPERLAYERREADY) ? PART_RECEIVER : PART_SENDER;
+}
+
+/* schedule an event of partition "part" from the running partition */
+static void schedule_event(Event *e, int part)
+{
+    ProfileScope scope(PROF_CHAIN);
+    e->origin = cur_part->id;
+    e->order = cur_part->scheduled++;
+    if (part==cur_part->id || !parallel_mode)
+	partitions[part].chain->schedule(e);
+    else {
+	if (cur_part->sent<0 || e->sched_time<cur_part->sent)
+	    cur_part->sent = e->sched_time;
+	partitions[part].inbox.push(e);
+    }
+}
+
+/* take the next event off a chain */
+static Event *take_event(EventChain *chain)
+{
+    ProfileScope scope(PROF_CHAIN);
+    return chain->next_event();
+}
+
+/* cancel an event of the running partition */
+static void cancel_event(Event *e)
+{
+    ProfileScope scope(PROF_CHAIN);
+    local_core()->cancel(e);
+}
+
+/* get simulation time (in seconds) - for both the sender and the receiver */
+double GetSimulationTime()
+{
+    return local_core()->time();
+}
+
+/* start the sender timer with a specified timeout (in seconds).
+   the timer is cancelled with Sender_StopTimer() is called or a new 
+   Sender_StartTimer() is called before the current timer expires.
+   Sender_Timeout() will be called when the timer expires. */
+void Sender_StartTimer(double timeout)
+{
+    ProfileScope scope(PROF_TIMER);
+    if (tracing_level>=1)
+	fprintf(stdout, "Time %.2fs (Sender): the timer is started (expires at %.2fs).\n",
+		local_core()->time(), local_core()->time() + timeout);
+
+    if (sender_timer!=NULL) {
+	cancel_event(sender_timer);
+	delete sender_timer;
+	sender_timer = NULL;
+    }
+
+    EventSenderTimeout *e = new EventSenderTimeout;
+    e->sched_time = local_core()->time() + timeout;
+    schedule_event(e, PART_SENDER);
+
+    sender_timer = e;
+}
+
+/* stop the sender timer */
+void Sender_StopTimer()
+{
+    ProfileScope scope(PROF_TIMER);
+    if (tracing_level>=1)
+	fprintf(stdout, "Time %.2fs (Sender): the timer is stopped.\n", 
+		local_core()->time());
+
+    if (sender_timer!=NULL) {
+	cancel_event(sender_timer);
+	delete sender_timer;
+	sender_timer = NULL;
+    }
+}
+
+/* check whether the sender timer is being set,
+   return true if the timer is set, return false otherwise */
+bool Sender_isTimerSet()
+{
+    return (sender_timer!=NULL);
+}
+
+/* pass a packet to the lower layer at the sender */
+void Sender_ToLowerLayer(struct packet *pkt)
+{
+    ProfileScope scope(PROF_CHANNEL);
+    s2r_channel.offered ++;
+
+    /* packet lost as the loss model decides */
+    if (s2r_channel.loss->lose()) {
+	s2r_channel.lost ++;
+	return;
+    }
+
+    EventReceiverFromLowerLayer *e = new EventReceiverFromLowerLayer;
+    memcpy(&e->pkt.data, pkt->data, RDT_PKTSIZE);
+
+    /* packet corrupted at rate "corrupt_rate" */
+    if (myrandom()<corrupt_rate) {
+	for (int i=0; i<RDT_PKTSIZE; i++) {
+	    e->pkt.data[i] = e->pkt.data[i] + (char)(myrandom()*20) - 10;
+	}
+	s2r_channel.corrupted ++;
+    }
+
+    /* in real time the packet crosses the loopback interface instead */
+    if (realtime_mode) {
+	send(sender_fd, e->pkt.data, RDT_PKTSIZE, 0);
+	delete e;
+	cur_part->pkts_passed ++;
+	return;
+    }
+
+    /* schedule the packet arrival event at the other side */
+    e->sched_time = local_core()->time() + s2r_channel.delay->delay();
+    schedule_event(e, PART_RECEIVER);
+
+    cur_part->pkts_passed ++;
+}
+
+
+/* pass a packet to the lower layer at the receiver */
+void Receiver_ToLowerLayer(struct packet *pkt)
+{
+    ProfileScope scope(PROF_CHANNEL);
+    r2s_channel.offered ++;
+
+    /* packet lost as the loss model decides */
+    if (r2s_channel.loss->lose()) {
+	r2s_channel.lost ++;
+	return;
+    }
+
+    EventSenderFromLowerLayer *e = new EventSenderFromLowerLayer;
+    memcpy(&e->pkt.data, pkt->data, RDT_PKTSIZE);
+
+    /* packet corrupted at rate "corrupt_rate" */
+    if (myrandom()<corrupt_rate) {
+	for (int i=0; i<RDT_PKTSIZE; i++) {
+	    e->pkt.data[i] = e->pkt.data[i] + (char)(myrandom()*20) - 10;
+	}
+	r2s_channel.corrupted ++;
+    }
+
+    /* in real time the packet crosses the loopback interface instead */
+    if (realtime_mode) {
+	send(receiver_fd, e->pkt.data, RDT_PKTSIZE, 0);
+	delete e;
+	cur_part->pkts_passed ++;
+	return;
+    }
+
+    /* schedule the packet arrival event at the other side */
+    e->sched_time = local_core()->time() + r2s_channel.delay->delay();
+    schedule_event(e, PART_SENDER);
+
+    cur_part->pkts_passed ++;
+}
+
+/* deliver a message to the upper layer at the receiver, the application 
+   verifies or keeps it */
+void Receiver_ToUpperLayer(struct message *msg)
+{
+    Receiver_ToUpperLayerOnStream(msg, 0);
+}
+
+void Receiver_ToUpperLayerOnStream(struct message *msg, int stream)
+{
+    ProfileScope scope(PROF_DELIVERY);
+    app->deliver(msg, stream);
+
+    if (tracing_level>=2)
+	fwrite(msg->data, 1, msg->size, stdout);
+
+    /* the upper layer is busy with the message for a while */
+    if (consume_time>0) {
+	receiver_upper_busy = true;
+	EventReceiverUpperLayerReady *e = new EventReceiverUpperLayerReady;
+	e->sched_time = local_core()->time() + consume_time;
+	schedule_event(e, PART_RECEIVER);
+    }
+}
+
+/* check whether the upper layer at the receiver is still busy with the last 
+   message */
+bool Receiver_isUpperLayerBusy()
+{
+    return receiver_upper_busy;
+}
+
+
+/* dump the counters of the rdt layer and the channels, one key=value pair 
+   per line */
+void print_protocol_metrics()
+{
+    fprintf(stdout, "sender.first_sent=%lld\n"
+	    "sender.timeout_resent=%lld\n"
+	    "sender.fast_resent=%lld\n"
+	    "sender.corrupted=%lld\n"
+	    "sender.acks_received=%lld\n"
+	    "sender.acks_ignored=%lld\n"
+	    "sender.acks_duplicate=%lld\n"
+	    "sender.window_stalls=%lld\n"
+	    "sender.rwnd_stalls=%lld\n"
+	    "sender.window_probes=%lld\n"
+	    "sender.naks_received=%lld\n"
+	    "sender.compressed=%lld\n"
+	    "sender.compress_ratio=%.3f\n"
+	    "sender.compress_ns_per_byte=%.3f\n"
+	    "sender.recovered=%lld\n"
+	    "sender.mean_recovery=%.6f\n"
+	    "sender.queue_depth=%lld\n"
+	    "sender.max_queue_depth=%lld\n",
+	    sender_stats.first_sent, sender_stats.timeout_resent, 
+	    sender_stats.fast_resent, sender_stats.corrupted, 
+	    sender_stats.acks_received, sender_stats.acks_ignored, 
+	    sender_stats.acks_duplicate, sender_stats.window_stalls, 
+	    sender_stats.rwnd_stalls, sender_stats.window_probes,
+	    sender_stats.naks_received, sender_stats.compressed, 
+	    sender_stats.compress_out ? (double)sender_stats.compress_in/sender_stats.compress_out : 0.0,
+	    sender_stats.compress_in ? sender_stats.compress_time*1e9/sender_stats.compress_in : 0.0,
+	    sender_stats.recovered,
+	    sender_stats.recovered ? sender_stats.recovery_time/sender_stats.recovered : 0.0,
+	    sender_stats.queue_depth, sender_stats.max_queue_depth);
+    fprintf(stdout, "receiver.delivered=%lld\n"
+	    "receiver.corrupted=%lld\n"
+	    "receiver.duplicates=%lld\n"
+	    "receiver.out_of_order=%lld\n"
+	    "receiver.acks_sent=%lld\n"
+	    "receiver.naks_sent=%lld\n"
+	    "receiver.window_drops=%lld\n"
+	    "receiver.window_updates=%lld\n"
+	    "receiver.max_buffered=%lld\n"
+	    "receiver.decompressed=%lld\n"
+	    "receiver.decompress_ns_per_byte=%.3f\n"
+	    "receiver.early_delivered=%lld\n",
+	    receiver_stats.delivered, receiver_stats.corrupted, 
+	    receiver_stats.duplicates, receiver_stats.out_of_order, 
+	    receiver_stats.acks_sent, receiver_stats.naks_sent, 
+	    receiver_stats.window_drops, receiver_stats.window_updates, 
+	    receiver_stats.max_buffered, receiver_stats.decompressed, 
+	    receiver_stats.decompress_out ? 
+	    receiver_stats.decompress_time*1e9/receiver_stats.decompress_out : 0.0,
+	    receiver_stats.early_delivered);
+    fprintf(stdout, "channel.s2r.offered=%lld\n"
+	    "channel.s2r.lost=%lld\n"
+	    "channel.s2r.corrupted=%lld\n"
+	    "channel.r2s.offered=%lld\n"
+	    "channel.r2s.lost=%lld\n"
+	    "channel.r2s.corrupted=%lld\n",
+	    s2r_channel.offered, s2r_channel.lost, s2r_channel.corrupted,
+	    r2s_channel.offered, r2s_channel.lost, r2s_channel.corrupted);
+}
+
+
+/*[]------------------------------------------------------------------------[]
+  |  checkpoints
+  []------------------------------------------------------------------------[]*/
+
+/* an empty event of the given type, NULL if there is no such type */
+static Event *new_event(int event_type)
+{
+    switch (event_type) {
+    case EVENT_SENDER_FROMUPPERLAYER: return new EventSenderFromUpperLayer;
+    case EVENT_SENDER_FROMLOWERLAYER: return new EventSenderFromLowerLayer;
+    case EVENT_SENDER_TIMEOUT: return new EventSenderTimeout;
+    case EVENT_RECEIVER_FROMLOWERLAYER: return new EventReceiverFromLowerLayer;
+    case EVENT_RECEIVER_UPPERLAYERREADY: return new EventReceiverUpperLayerReady;
+    }
+    return NULL;
+}
+
+/* the pending events in chain order.  they are saved from the single chain 
+   of a sequential run and restored into the chain of their partition, so a 
+   parallel run can continue a checkpoint too */
+static void checkpoint_events(Checkpoint &ck)
+{
+    long long n = 0;
+    for (Event *e = sim_core.head; ck.writing && e!=NULL; e = e->next)
+	n++;
+    ck.value(n);
+
+    Event *e = sim_core.head;
+    Event **tails[NUM_PARTS];
+    for (int i=0; i<NUM_PARTS; i++)
+	tails[i] = &partitions[i].chain->head;
+    for (long long i=0; ck.ok && i<n; i++) {
+	int type = ck.writing ? e->event_type : -1;
+	ck.value(type);
+	if (!ck.writing && (e = new_event(type))==NULL) {
+	    ck.ok = false;
+	    break;
+	}
+	bool timer = e==sender_timer;
+	ck.value(e->sched_time);
+	ck.value(e->origin);
+	ck.value(e->order);
+	ck.value(timer);
+	if (type==EVENT_SENDER_FROMLOWERLAYER)
+	    ck.value(((EventSenderFromLowerLayer*) e)->pkt);
+	else if (type==EVENT_RECEIVER_FROMLOWERLAYER)
+	    ck.value(((EventReceiverFromLowerLayer*) e)->pkt);
+
+	if (ck.writing) {
+	    e = e->next;
+	    continue;
+	}
+	if (timer) sender_timer = e;
+	EventChain *chain = partitions[event_partition(type)].chain;
+	for (int j=0; j<NUM_PARTS; j++) {
+	    if (partitions[j].chain!=chain) continue;
+	    *tails[j] = e; /* the partitions of a sequential run share the chain */
+	    tails[j] = &e->next;
+	}
+    }
+}
+
+/* the engine, the channels, the rdt layer and the upper layers, in this 
+   order */
+static void checkpoint_state(Checkpoint &ck)
+{
+    ck.expect(CHECKPOINT_MAGIC);
+    ck.expect((int) RDT_PKTSIZE);
+    ck.expect(sizeof(Sender_Stats) + sizeof(Receiver_Stats));
+
+    ck.value(sim_core.sim_time);
+    if (!ck.writing) receiver_core.sim_time = sim_core.sim_time;
+    for (int i=0; i<NUM_PARTS; i++) {
+	Partition *p = &partitions[i];
+	ck.value(p->rng);
+	ck.value(p->scheduled);
+	ck.value(p->events);
+	ck.value(p->batches);
+	ck.value(p->batched);
+	ck.value(p->pkts_passed);
+    }
+    ck.value(receiver_upper_busy);
+
+    Channel *channels[] = {&s2r_channel, &r2s_channel};
+    for (int i=0; i<2; i++) {
+	ck.value(channels[i]->offered);
+	ck.value(channels[i]->lost);
+	ck.value(channels[i]->corrupted);
+	ck.model(channels[i]->loss);
+	ck.model(channels[i]->delay);
+    }
+
+    checkpoint_events(ck);
+    Sender_Checkpoint(ck);
+    Receiver_Checkpoint(ck);
+    app->checkpoint(ck);
+}
+
+static bool take_checkpoint(const char *path)
+{
+    FILE *fp = fopen(path, "wb");
+    if (fp==NULL) return false;
+    Checkpoint ck(fp, true);
+    checkpoint_state(ck);
+    return fclose(fp)==0 && ck.ok;
+}
+
+/* the whole file must be read, a longer one was saved by another build */
+static bool restore_checkpoint(const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp==NULL) return false;
+    Checkpoint ck(fp, false);
+    checkpoint_state(ck);
+    bool ok = ck.ok && fgetc(fp)==EOF;
+    fclose(fp);
+    return ok;
+}
+
+
+/*[]------------------------------------------------------------------------[]
+  |  simulation engines
+  []------------------------------------------------------------------------[]*/
+
+/* hand e and the packet arrivals of the same side and time right behind it 
+   on the chain to the rdt layer together.  they are taken in chain order, 
+   so no other event runs between them that would not have anyway */
+static void dispatch_batch(Event *e)
+{
+    EventChain *chain = local_core();
+    Event *batch[MAX_BATCH];
+    struct packet *pkts[MAX_BATCH];
+    int n = 0;
+
+    batch[n++] = e;
+    while (n<MAX_BATCH && chain->head!=NULL && chain->head->event_type==e->event_type && 
+	   chain->head->sched_time==e->sched_time)
+	batch[n++] = take_event(chain);
+    cur_part->events += n-1;
+    cur_part->batches++;
+    cur_part->batched += n;
+
+    bool to_receiver = e->event_type==EVENT_RECEIVER_FROMLOWERLAYER;
+    if (tracing_level>=1) {
+	fprintf(stdout, "Time %.2fs (%s): the lower layer informs the rdt layer that %d packets are received from the link.\n", 
+		local_core()->time(), to_receiver ? "Receiver" : "Sender", n);
+    }
+
+    for (int i=0; i<n; i++)
+	pkts[i] = to_receiver ? &((EventReceiverFromLowerLayer*) batch[i])->pkt : 
+	    &((EventSenderFromLowerLayer*) batch[i])->pkt;
+    if (to_receiver)
+	Receiver_FromLowerLayerBatch(pkts, n);
+    else {
+	Sender_FromLowerLayerBatch(pkts, n);
+	app->sender_progress();
+    }
+
+    for (int i=0; i<n; i++) {
+	if (to_receiver)
+	    delete (EventReceiverFromLowerLayer*) batch[i];
+	else
+	    delete (EventSenderFromLowerLayer*) batch[i];
+    }
+}
+
+/* handle one event of the running partition */
+static void dispatch(Event *e)
+{
+    ProfileScope scope(e->event_type);
+    if (batch_dispatch && (e->event_type==EVENT_SENDER_FROMLOWERLAYER || 
+			   e->event_type==EVENT_RECEIVER_FROMLOWERLAYER)) {
+	dispatch_batch(e);
+	return;
+    }
+
+    switch (e->event_type) {
+    case EVENT_SENDER_FROMUPPERLAYER:
+	{
+	    if (tracing_level>=1) {
+		fprintf(stdout, "Time %.2fs (Sender): the upper layer instructs rdt layer to send out a message.\n", local_core()->time());
+	    }
+
+	    EventSenderFromUpperLayer *real_e = (EventSenderFromUpperLayer*) e;
+
+	    /* the application passes its message down, schedule the next one */
+	    double interval = app->send_next();
+	    if (interval >= 0) {
+		real_e->sched_time = local_core()->time() + interval;
+		schedule_event(real_e, PART_SENDER);
+	    }
+	    else
+		delete real_e;
+	}
+	break;
+
+    case EVENT_SENDER_FROMLOWERLAYER:
+	{
+	    if (tracing_level>=1) {
+		fprintf(stdout, "Time %.2fs (Sender): the lower layer informs the rdt layer that a packet is received from the link.\n", local_core()->time());
+	    }
+
+	    EventSenderFromLowerLayer *real_e = (EventSenderFromLowerLayer*) e;
+
+	    Sender_FromLowerLayer(&real_e->pkt);
+	    app->sender_progress();
+
+	    delete real_e;
+	}
+	break;
+
+    case EVENT_SENDER_TIMEOUT:
+	{
+	    if (tracing_level>=1) {
+		fprintf(stdout, "Time %.2fs (Sender): the timer expires.\n", local_core()->time());
+	    }
+
+	    EventSenderTimeout *real_e = (EventSenderTimeout*) e;
+	    delete real_e;
+	    sender_timer = NULL;
+
+	    Sender_Timeout();
+	}
+	break;
+
+    case EVENT_RECEIVER_FROMLOWERLAYER:
+	{
+	    if (tracing_level>=1) {
+		fprintf(stdout, "Time %.2fs (Receiver): the lower layer informs the rdt layer that a packet is received from the link.\n", local_core()->time());
+	    }
+
+	    EventReceiverFromLowerLayer *real_e = (EventReceiverFromLowerLayer*) e;
+
+	    Receiver_FromLowerLayer(&real_e->pkt);
+
+	    delete real_e;
+	}
+	break;
+
+    case EVENT_RECEIVER_UPPERLAYERREADY:
+	{
+	    if (tracing_level>=1) {
+		fprintf(stdout, "Time %.2fs (Receiver): the upper layer is ready for the next message.\n", local_core()->time());
+	    }
+
+	    EventReceiverUpperLayerReady *real_e = (EventReceiverUpperLayerReady*) e;
+	    delete real_e;
+	    receiver_upper_busy = false;
+
+	    Receiver_UpperLayerReady();
+	}
+	break;
+
+    default:
+	fprintf(stderr, "undefined event %d\n", e->event_type);
+	break;
+    }
+}
+
+/* the original engine: a single chain for both partitions */
+static void run_sequential()
+{
+    for (;;) {
+	if (checkpoint_path!=NULL && sim_core.head!=NULL && sim_core.head->sched_time>checkpoint_time) {
+	    if (!take_checkpoint(checkpoint_path))
+		fprintf(stderr, "cannot write the checkpoint %s\n", checkpoint_path);
+	    checkpoint_path = NULL;
+	}
+
+	Event *e = take_event(&sim_core);
+	if (e==NULL) break;
+
+	cur_part = &partitions[event_partition(e->event_type)];
+	cur_part->events++;
+	dispatch(e);
+    }
+}
+
+/* conservative parallel engine.  at the end of every round each partition 
+   publishes its earliest event and the earliest one it sent the other, then 
+   both pass a single barrier, collect their inboxes and work out the earliest 
+   time E at which either side has an event.  the other side can act no 
+   earlier than min(E_other, E_own+lookahead), and what it sends arrives a 
+   lookahead later, so each partition runs its events before that without 
+   waiting, up to two lookaheads when the other side is idle.  the published 
+   values alternate between two slots, one partition may publish the next 
+   round's while the other still reads this one's.  equal times are broken 
+   by Event::before(), so the partitions see their events in the same order 
+   as in run_sequential() */
+struct RoundInfo {
+    double head;            /* earliest event in the chain, -1 if none */
+    double sent;            /* earliest event sent to the other partition */
+};
+
+static SpinBarrier round_barrier(NUM_PARTS);
+static RoundInfo round_info[2][NUM_PARTS];
+
+/* the earlier of two event times, -1 standing for none */
+static double earliest(double a, double b)
+{
+    return a<0 || (b>=0 && b<a) ? b : a;
+}
+
+static void run_partition(Partition *p)
+{
+    cur_part = p;
+    p->sent = -1;
+    int other = NUM_PARTS-1-p->id;
+    for (int round=0; ; round++) {
+	RoundInfo *info = round_info[round&1];
+	info[p->id].head = p->chain->next_time();
+	info[p->id].sent = p->sent;
+	p->sent = -1;
+	round_barrier.wait();
+
+	/* everything the other side sent before the barrier is here now;
+	   what it sends in the next round is later than this round's end */
+	for (Event *e; (e = p->inbox.pop())!=NULL; )
+	    p->chain->schedule(e);
+
+	double mine = earliest(info[p->id].head, info[other].sent);
+	double theirs = earliest(info[other].head, info[p->id].sent);
+	if (mine<0 && theirs<0) break;
+	if (mine<0) continue;
+
+	double end = (theirs<0 ? mine+lookahead : earliest(theirs, mine+lookahead)) + lookahead;
+	while (p->chain->head!=NULL && p->chain->head->sched_time<end) {
+	    Event *e = take_event(p->chain);
+	    p->events++;
+	    dispatch(e);
+	}
+    }
+}
+
+static void run_parallel()
+{
+    std::thread receiver_thread(run_partition, &partitions[PART_RECEIVER]);
+    run_partition(&partitions[PART_SENDER]);
+    receiver_thread.join();
+
+    /* both partitions end at the time of the last event */
+    if (receiver_core.time() > sim_core.time())
+	sim_core.sim_time = receiver_core.time();
+    receiver_core.sim_time = sim_core.time();
+}
+
+/* the packets waiting at a socket become arrival events at time "now" */
+static void receive_packets(int fd, int part, double now)
+{
+    for (;;) {
+	struct packet pkt;
+	if (recv(fd, pkt.data, RDT_PKTSIZE, MSG_DONTWAIT)!=RDT_PKTSIZE) break;
+
+	Event *e;
+	if (part==PART_RECEIVER) {
+	    EventReceiverFromLowerLayer *arrival = new EventReceiverFromLowerLayer;
+	    arrival->pkt = pkt;
+	    e = arrival;
+	}
+	else {
+	    EventSenderFromLowerLayer *arrival = new EventSenderFromLowerLayer;
+	    arrival->pkt = pkt;
+	    e = arrival;
+	}
+	e->sched_time = now;
+	cur_part = &partitions[part==PART_RECEIVER ? PART_SENDER : PART_RECEIVER];
+	schedule_event(e, part);
+    }
+}
+
+/* real-time engine: the simulation time follows the wall clock, the timers 
+   and the upper layers stay events on the chain, and the packets go through 
+   the sockets.  the run ends when no event is left and no packet is on the 
+   way */
+static void run_realtime()
+{
+    double start = wall_time();
+    for (;;) {
+	double now = wall_time() - start;
+	receive_packets(receiver_fd, PART_RECEIVER, now);
+	receive_packets(sender_fd, PART_SENDER, now);
+
+	while (sim_core.head!=NULL && sim_core.head->sched_time<=now) {
+	    Event *e = take_event(&sim_core);
+	    cur_part = &partitions[event_partition(e->event_type)];
+	    cur_part->events++;
+	    dispatch(e);
+	}
+
+	struct pollfd fds[2] = {{receiver_fd, POLLIN, 0}, {sender_fd, POLLIN, 0}};
+	double wait = sim_core.head==NULL ? 0 : sim_core.head->sched_time - (wall_time() - start);
+	if (wait < 0) wait = 0;
+	struct timespec timeout = {(time_t) wait, (long) ((wait - (time_t) wait)*1e9)};
+	if (ppoll(fds, 2, &timeout, NULL)==0 && sim_core.head==NULL) break;
+    }
+}
+
+/* a UDP socket on the loopback interface */
+static int loopback_socket(struct sockaddr_in *addr)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd<0) return -1;
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(*addr);
+    if (bind(fd, (struct sockaddr*) addr, len)<0 || 
+	getsockname(fd, (struct sockaddr*) addr, &len)<0) {
+	close(fd);
+	return -1;
+    }
+    return fd;
+}
+
+/* connect the sender and the receiver sockets to each other */
+static bool open_loopback()
+{
+    struct sockaddr_in sender_addr, receiver_addr;
+    sender_fd = loopback_socket(&sender_addr);
+    receiver_fd = loopback_socket(&receiver_addr);
+    if (sender_fd<0 || receiver_fd<0) return false;
+    return connect(sender_fd, (struct sockaddr*) &receiver_addr, sizeof(receiver_addr))==0 && 
+	connect(receiver_fd, (struct sockaddr*) &sender_addr, sizeof(sender_addr))==0;
+}
+
+
+/*[]------------------------------------------------------------------------[]
+  |  simulation control
+  []------------------------------------------------------------------------[]*/
+
+void sim_init(unsigned int seed)
+{
+    /* initialize the partitions and their random number generators */
+    for (int i=0; i<NUM_PARTS; i++) {
+	partitions[i].id = i;
+	partitions[i].chain = &sim_core;
+	partitions[i].rng.seed(((unsigned long long)seed << 1) | i);
+    }
+    cur_part = &partitions[PART_SENDER];
+}
+
+bool sim_prepare()
+{
+    if (realtime_mode && (checkpoint_path!=NULL || restore_path!=NULL)) {
+	fprintf(stderr, "a real-time run has no checkpoints\n");
+	return false;
+    }
+    if (parallel_mode && checkpoint_path!=NULL) {
+	fprintf(stderr, "checkpoints are taken by the sequential engine, running sequentially\n");
+	parallel_mode = false;
+    }
+    if (realtime_mode) {
+	parallel_mode = false;
+	if (!open_loopback()) {
+	    perror("loopback socket");
+	    return false;
+	}
+    }
+    /* how far the link may reorder the data packets, the loopback interface
+       keeps them in order */
+    if (realtime_mode)
+	rdt_config.reorder = 0;
+    else if (s2r_channel.delay->max_delay()<0)
+	rdt_config.reorder = NAK_REORDER;
+    else
+	rdt_config.reorder = s2r_channel.delay->max_delay() - s2r_channel.delay->min_delay();
+    if (parallel_mode) {
+	lookahead = s2r_channel.delay->min_delay();
+	if (r2s_channel.delay->min_delay() < lookahead)
+	    lookahead = r2s_channel.delay->min_delay();
+	if (lookahead > 0)
+	    partitions[PART_RECEIVER].chain = &receiver_core;
+	else {
+	    fprintf(stderr, "the link has no minimum latency to look ahead, "
+		    "running sequentially\n");
+	    parallel_mode = false;
+	}
+    }
+    return true;
+}
+
+void sim_run(Application *application)
+{
+    app = application;
+
+    /* intialize the sender and the receiver */
+    Sender_Init();
+    Receiver_Init();
+
+    /* scheduling a recurring message arrival event, or the events of the 
+       checkpoint the run continues from */
+    if (restore_path!=NULL) {
+	if (!restore_checkpoint(restore_path)) {
+	    fprintf(stderr, "cannot restore the checkpoint %s\n", restore_path);
+	    exit(-1);
+	}
+    }
+    else {
+	double first = app->first_arrival();
+	if (first >= 0) {
+	    EventSenderFromUpperLayer *e = new EventSenderFromUpperLayer;
+	    e->sched_time = first;
+	    schedule_event(e, PART_SENDER);
+	}
+    }
+
+    /* main simulation cycle */
+    double wall_start = wall_time();
+    if (realtime_mode)
+	run_realtime();
+    else if (parallel_mode)
+	run_parallel();
+    else
+	run_sequential();
+    wall_seconds = wall_time() - wall_start;
+    if (checkpoint_path!=NULL)
+	fprintf(stderr, "the run ended before %.3fs, no checkpoint was taken\n", checkpoint_time);
+
+    cur_part = &partitions[PART_SENDER];
+    for (int i=0; i<NUM_PARTS; i++) {
+	tot_events += partitions[i].events;
+	tot_batches += partitions[i].batches;
+	tot_batched += partitions[i].batched;
+	tot_pkts_passed += partitions[i].pkts_passed;
+    }
+
+    /* finalize the sender and the receiver */
+    Sender_Final();
+    Receiver_Final();
+
+    if (realtime_mode) {
+	close(sender_fd);
+	close(receiver_fd);
+    }
+}
+
+double sim_end_time()
+{
+    return sim_core.time();
+}
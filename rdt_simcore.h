@@ -0,0 +1,81 @@
+/*
+ * FILE: rdt_simcore.h
+ * DESCRIPTION: The simulation core shared by rdt_sim and rdt_xfer.  A program
+ *              sets up the channels, calls sim_init() and sim_prepare(), and
+ *              runs its upper layers on top of the rdt layer with sim_run().
+ */
+
+
+#ifndef _RDT_SIMCORE_H_
+#define _RDT_SIMCORE_H_
+
+#include "rdt_struct.h"
+#include "rdt_channel.h"
+
+class Checkpoint;
+
+/* the upper layers at both ends of the rdt layer */
+class Application
+{
+public:
+    virtual ~Application() {}
+    /* time of the first message at the sender, negative if there is none */
+    virtual double first_arrival() = 0;
+    /* the upper layer at the sender passes its next message down with
+       Sender_FromUpperLayer(), return the time until the next one, negative
+       if there is none */
+    virtual double send_next() = 0;
+    /* a message delivered to the upper layer at the receiver on a stream,
+       0 unless it was sent with Sender_FromUpperLayerOnStream().  msg->data
+       is only valid during the call */
+    virtual void deliver(struct message *msg, int stream) = 0;
+    /* the rdt layer at the sender took packets from the link, acks may have
+       come in and drained the send queue */
+    virtual void sender_progress() {}
+    /* save the state of the upper layers into a checkpoint, or restore it */
+    virtual void checkpoint(Checkpoint &ck) {}
+};
+
+/* settings of the simulation, fixed before sim_prepare() */
+extern double corrupt_rate;
+extern Channel s2r_channel, r2s_channel;
+extern double consume_time;
+extern int tracing_level;
+extern bool parallel_mode;
+extern bool realtime_mode;
+extern bool batch_dispatch;
+
+/* write the state of the run to checkpoint_path once every event up to
+   checkpoint_time has run (sequential engine only), or continue a run from
+   the checkpoint at restore_path instead of starting at time 0 */
+extern const char *checkpoint_path;
+extern double checkpoint_time;
+extern const char *restore_path;
+
+/* statistics of the run */
+extern int tot_pkts_passed;
+extern long long tot_events;
+extern long long tot_batches, tot_batched;
+extern double wall_seconds;
+
+/* seed the random number generators, myrandom() can be used afterwards */
+void sim_init(unsigned int seed);
+
+/* set up the engine for the channels: the lookahead of a parallel run, the
+   sockets of a real-time one.  return false if it cannot run */
+bool sim_prepare();
+
+/* run the sender and the receiver with the application on top until no
+   event is left */
+void sim_run(Application *application);
+
+/* the time of the last event of the run */
+double sim_end_time();
+
+/* wall clock (in seconds) */
+double wall_time();
+
+/* the sender.*, receiver.* and channel.* counters as key=value lines */
+void print_protocol_metrics();
+
+#endif  /* _RDT_SIMCORE_H_ */
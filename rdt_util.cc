@@ -1,26 +1,98 @@
 #include "rdt_util.h"
 #include "rdt_struct.h"
+#include "rdt_profile.h"
 #include <iostream>
 #include <cstring>
+#include <time.h>
+
+Rdt_Config rdt_config;
+
+// the bytes the checksum covers, the header and the payload
+static inline int checked_size(packet *packet) {
+    Header h;
+    int offset = decode_header(packet, &h);
+    return offset < 0 ? PAYLOAD_END : offset + h.size; // a corrupted header
+}
 
 unsigned short calc_checksum(packet *packet) {
-    int res = 0;
-    int size = packet->data[0] + HEADER_SIZE;
+    ProfileScope scope(PROF_CHECKSUM);
+    unsigned int res = 0;
+    int size = checked_size(packet);
     for (int i = 0; i < size; ++i) {
         res = res * BASE_NUMBER + packet->data[i] + BIOS_NUMBER;
     }
     return res & 0XFFFF;
 }
 
+// a corrupted header may still match the 16-bit checksum, never let it index the windows
+static inline bool check_header(packet *packet) {
+    Header h;
+    int offset = decode_header(packet, &h);
+    if (offset < 0 || h.seq > MAX_SEQ || h.stream >= MAX_STREAMS || h.size == 0) return false;
+    if ((h.flags & FLAG_NAK) && h.flags != FLAG_NAK) return false; // a nak is never compressed or on a stream
+    // encode_header() writes a header only one way: the shortest varints, and
+    // a length only where the payload does not fill the packet
+    struct packet canonical;
+    return encode_header(&canonical, &h) == offset && memcmp(canonical.data, packet->data, offset) == 0;
+}
+
+static inline unsigned short stored_checksum(packet *packet) {
+    return (((unsigned char)packet->data[RDT_PKTSIZE - TAIL_SIZE]) << 8)
+            + (unsigned char) packet->data[RDT_PKTSIZE - TAIL_SIZE + 1];
+}
+
 bool check_packet(packet *packet) {
     ASSERT(packet);
+    if (!check_header(packet)) return false;
     unsigned short actual_checksum = calc_checksum(packet);
-    unsigned short origin_checksum = (((unsigned char)packet->data[RDT_PKTSIZE - TAIL_SIZE]) << 8)
-            + (unsigned char) packet->data[RDT_PKTSIZE - TAIL_SIZE + 1];
+    unsigned short origin_checksum = stored_checksum(packet);
     //printf("origin: %hd, actual:%hd\n", origin_checksum, actual_checksum);
     return (origin_checksum == actual_checksum);
 }
 
+// 8 checksums in the lanes of a vector. only the low 16 bits of the sum are
+// kept, and they only depend on the low 16 bits of each step, so 16-bit lanes
+// give the same result as calc_checksum()
+#define CHECKSUM_LANES 8
+typedef unsigned short checksum_lanes __attribute__((vector_size(2 * CHECKSUM_LANES)));
+
+static void calc_checksum_lanes(packet **packets, int n, unsigned short *sums) {
+    ProfileScope scope(PROF_CHECKSUM);
+    checksum_lanes res = {}, size = {}, idx = {};
+    int max_size = 0;
+    for (int j = 0; j < n; ++j) {
+        int s = checked_size(packets[j]);
+        size[j] = (unsigned short) s;
+        if (s > max_size) max_size = s;
+    }
+    for (int i = 0; i < max_size; ++i) {
+        checksum_lanes bytes = {};
+        for (int j = 0; j < n; ++j)
+            bytes[j] = (unsigned short)(signed char) packets[j]->data[i];
+        checksum_lanes next = res * BASE_NUMBER + bytes + BIOS_NUMBER;
+        checksum_lanes live = idx < size; // lanes still inside their packet
+        res = (next & live) | (res & ~live);
+        idx += 1;
+    }
+    for (int j = 0; j < n; ++j) sums[j] = res[j];
+}
+
+void check_packets(packet **packets, int n, bool *ok) {
+    unsigned short sums[CHECKSUM_LANES];
+    for (int first = 0; first < n; first += CHECKSUM_LANES) {
+        int lanes = n - first < CHECKSUM_LANES ? n - first : CHECKSUM_LANES;
+        if (lanes == 1) { // nothing to run side by side
+            ok[first] = check_packet(packets[first]);
+            continue;
+        }
+        calc_checksum_lanes(packets + first, lanes, sums);
+        for (int j = 0; j < lanes; ++j) {
+            packet *packet = packets[first + j];
+            ok[first + j] = check_header(packet) && sums[j] == stored_checksum(packet);
+        }
+    }
+}
+
 // a <= b < c
 static bool between(int a, int b, int c) {
     if ((a <= b && b < c) || (c < a && a <= b) || ((b < c) && (c < a)))
@@ -34,6 +106,16 @@ void build_checksum(packet *packet) {
     packet->data[RDT_PKTSIZE - TAIL_SIZE + 1] = (char)(checksum & 0XFF);
 }
 
+double rdt_clock() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int seq_distance(int from, int seq) {
+    return seq >= from ? seq - from : MAX_SEQ + 1 + seq - from;
+}
+
 bool this_turn(int seq, int window_head) {
     if (seq > window_head && seq < window_head + MAX_WINDOW) return true;
     if (seq < window_head && MAX_SEQ + seq - window_head < MAX_WINDOW - 1) return true;
@@ -6,16 +6,25 @@
 #define RDT_RDT_UTIL_H
 
 #include "rdt_struct.h"
+#include "rdt_header.h"
 
 #define MAX_SEQ 10
 #define MAX_WINDOW (MAX_SEQ >> 1)
 #define SEND_BUFFER 128
-#define HEADER_SIZE 2
-#define TAIL_SIZE 2
-#define MAX_PAYLOAD (RDT_PKTSIZE - HEADER_SIZE - TAIL_SIZE)
+#if RDT_PKTSIZE < 64 || RDT_PKTSIZE > 9000
+#error "RDT_PKTSIZE must be from 64 to 9000"
+#endif
+#define MAX_PAYLOAD (PAYLOAD_END - 1)  // a full data packet off any stream
 #define BASE_NUMBER 73
 #define BIOS_NUMBER 27
 #define TIMEOUT 0.3
+#define MAX_STREAMS 64
+#define NAK_INTERVAL 0.2    // a missing sequence number is reported at most once per interval
+#define NAK_REORDER 0.2     // rdt_config.reorder when the delay has no upper bound
+#define RECV_BUFFER MAX_WINDOW  // packets the receiver holds, out of order or not yet delivered
+#define ACK_SIZE 2          // ack payload: the next expected seq, the advertised window
+                            // (then more acked seqs when acks are coalesced)
+#define MAX_BATCH 32        // packets handed to a *_FromLowerLayerBatch() at once
 #define DEBUG(format, ...) do { \
     if (false)    {               \
         fprintf(stdout, "%f %s %s(Line %d):", GetSimulationTime(), __FILE__, __FUNCTION__, __LINE__);\
@@ -41,15 +50,89 @@ struct Time_pair {
     }
 };
 
+/* protocol counters, cheap enough to stay on in every build.
+   they are printed by Sender_Final()/Receiver_Final() and exported by the
+   simulator's batch-mode metrics */
+struct Sender_Stats {
+    long long first_sent;       // packets transmitted for the first time
+    long long timeout_resent;   // retransmissions caused by an expired logical clock
+    long long fast_resent;      // retransmissions before the clock expired: on a nak, or
+                                // when the receiver's window reopens over a probe
+    long long corrupted;        // packets dropped by check_packet()
+    long long acks_received;    // acks that advanced the window or were buffered
+    long long acks_ignored;     // acks too old for the current window
+    long long acks_duplicate;   // acks for a sequence already buffered
+    long long window_stalls;    // times packets got stuck waiting on a full window
+    long long rwnd_stalls;      // ... on the receiver's full advertised window
+    long long window_probes;    // packets sent into a closed receiver window
+    long long naks_received;
+    long long compressed;       // packets sent with a compressed payload
+    long long compress_in;      // message bytes they carry
+    long long compress_out;     // their payload bytes
+    double compress_time;       // seconds spent in rdt_compress()
+    long long recovered;        // acked packets that needed a retransmission
+    double recovery_time;       // total time from their first transmission to the ack
+    long long queue_depth;      // packets waiting in the send queue
+    long long max_queue_depth;
+    long long queued;           // packets ever put in the send queue
+    long long acked;            // of them, acked in queue order
+};
+
+struct Receiver_Stats {
+    long long delivered;        // packets passed to the upper layer
+    long long corrupted;        // packets dropped by check_packet()
+    long long duplicates;       // packets of a previous turn, or already buffered
+    long long out_of_order;     // packets stored in buffered_packets
+    long long acks_sent;
+    long long naks_sent;
+    long long decompressed;     // compressed packets delivered
+    long long decompress_out;   // message bytes they expanded to
+    double decompress_time;     // seconds spent in rdt_decompress()
+    long long window_drops;     // packets beyond the advertised window, dropped
+    long long window_updates;   // acks sent because the window reopened
+    long long max_buffered;     // peak of out-of-order plus undelivered packets
+    long long early_delivered;  // stream packets delivered ahead of a gap in another stream
+};
+
+/* protocol options, set by the simulator before Sender_Init()/Receiver_Init() */
+struct Rdt_Config {
+    bool nak;                   // the receiver reports gaps with NAKs
+    bool compress;              // the sender compresses messages that shrink
+    int arq;                    // ARQ_SR, ARQ_GBN or ARQ_SAW of rdt_arq.h
+    double reorder;             // how long a data packet may trail the ones sent after it,
+                                // 0 on a link that keeps them in order
+};
+
+extern Rdt_Config rdt_config;
+
+extern Sender_Stats sender_stats;
+extern Receiver_Stats receiver_stats;
+
 void build_checksum(packet *packet);
 
 unsigned short calc_checksum(packet *packet);
 
 bool check_packet(packet *packet);
 
+/* check_packet() of n packets, their checksums computed side by side */
+void check_packets(packet **packets, int n, bool *ok);
+
+/* the sequence number of a packet, without its flags */
+inline int packet_seq(packet *packet) {
+    Header h;
+    decode_header(packet, &h);
+    return h.seq;
+}
+
+/* a monotonic clock in seconds, for the cost counters */
+double rdt_clock();
+
 static bool between(int a, int b, int c);
 
 bool this_turn(int seq, int window_head);
 
+/* how far seq is ahead of from in the sequence space */
+int seq_distance(int from, int seq);
+
 
 #endif //RDT_RDT_UTIL_H
@@ -0,0 +1,221 @@
+#include "rdt_workload.h"
+#include "rdt_channel.h"
+#include "rdt_checkpoint.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+int Workload::size() {
+    int n = (int)(myrandom() * 2.0 * mean_size);
+    return n == 0 ? 1 : n;
+}
+
+int ParetoWorkload::size() {
+    double u = myrandom();
+    if (u <= 0) u = 1e-12;
+    double n = min_size * pow(u, -1.0 / alpha);
+    return n > max_size ? max_size : (int) n;
+}
+
+static double exponential(double mean) {
+    double u = myrandom();
+    if (u >= 1) u = 1 - 1e-12;
+    return -mean * log(1 - u);
+}
+
+OnOffWorkload::OnOffWorkload(double interval_, int size_, double on_, double off_)
+        : Workload(interval_, size_), on_mean(on_), off_mean(off_), clock(0) {
+    on_until = exponential(on_mean);
+}
+
+double OnOffWorkload::interval() {
+    double next = clock + Workload::interval();
+    if (next > on_until) { // the burst is over, stay silent until the next one
+        next = on_until + exponential(off_mean);
+        on_until = next + exponential(on_mean);
+    }
+    double d = next - clock;
+    clock = next;
+    return d;
+}
+
+void OnOffWorkload::checkpoint(Checkpoint &ck) {
+    ck.value(clock);
+    ck.value(on_until);
+}
+
+bool TraceWorkload::load(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) return false;
+    double t;
+    int size;
+    while (fscanf(fp, "%lf %d", &t, &size) == 2) {
+        if (t < 0 || size <= 0 || (!times.empty() && t < times.back())) {
+            fclose(fp);
+            return false;
+        }
+        times.push_back(t);
+        sizes.push_back(size);
+    }
+    fclose(fp);
+    return !times.empty();
+}
+
+double TraceWorkload::interval() {
+    if (cursor + 1 >= times.size()) return -1;
+    cursor++;
+    return times[cursor] - times[cursor - 1];
+}
+
+void TraceWorkload::checkpoint(Checkpoint &ck) {
+    ck.value(cursor);
+    if (cursor >= times.size()) cursor = times.size() - 1; // restored with a shorter trace
+}
+
+Workload *make_workload(const char *spec, double mean_interval, int mean_size) {
+    double a[3];
+    int n;
+    if (strcmp(spec, "uniform") == 0)
+        return new Workload(mean_interval, mean_size);
+    if (parse_spec(spec, "bimodal", a, 3) == 3 && a[0] >= 1 && a[1] >= 1 && is_prob(a[2]))
+        return new BimodalWorkload(mean_interval, (int) a[0], (int) a[1], a[2]);
+    if ((n = parse_spec(spec, "pareto", a, 3)) >= 2 && a[0] >= 1 && a[1] > 0) {
+        if (n < 3) a[2] = 1 << 20;
+        if (a[2] >= a[0])
+            return new ParetoWorkload(mean_interval, (int) a[0], a[1], (int) a[2]);
+    }
+    if (parse_spec(spec, "onoff", a, 2) == 2 && a[0] > 0 && a[1] >= 0)
+        return new OnOffWorkload(mean_interval, mean_size, a[0], a[1]);
+    if (strncmp(spec, "trace:", 6) == 0) {
+        TraceWorkload *workload = new TraceWorkload;
+        if (workload->load(spec + 6)) return workload;
+        delete workload;
+    }
+    return NULL;
+}
+
+// the digits pattern is periodic with period 10: copying or comparing
+// DIGITS_CHUNK bytes from digits_table + (offset % 10) covers a whole chunk,
+// and DIGITS_CHUNK is a multiple of 10 so the phase is the same afterwards
+#define DIGITS_CHUNK 240
+static char digits_table[10 + DIGITS_CHUNK];
+
+static struct DigitsTableInit {
+    DigitsTableInit() {
+        for (int i = 0; i < 10 + DIGITS_CHUNK; ++i)
+            digits_table[i] = '0' + i % 10;
+    }
+} digits_table_init;
+
+// 8 bytes of the random pattern, starting at an offset that is a multiple of 8
+static inline unsigned long long random_word(long long offset) {
+    unsigned long long x = (unsigned long long)(offset >> 3) + 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+static inline char random_byte(long long offset) {
+    return (char)(random_word(offset) >> ((offset & 7) * 8));
+}
+
+// index of the first byte where a and b differ within n bytes, or -1
+static inline int first_difference(const char *a, const char *b, int n) {
+    int i = 0;
+#ifdef __SSE2__
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i*)(b + i));
+        unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) ^ 0xFFFF;
+        if (mask) return i + __builtin_ctz(mask);
+    }
+#else
+    if (memcmp(a, b, n) == 0) return -1;
+#endif
+    for (; i < n; ++i)
+        if (a[i] != b[i]) return i;
+    return -1;
+}
+
+void Pattern::fill(char *data, int size) {
+    if (kind == DIGITS) {
+        const char *table = digits_table + fill_offset % 10;
+        int i = 0;
+        for (; i + DIGITS_CHUNK <= size; i += DIGITS_CHUNK)
+            memcpy(data + i, table, DIGITS_CHUNK);
+        memcpy(data + i, table, size - i);
+    } else {
+        long long offset = fill_offset;
+        int i = 0;
+        for (; i < size && (offset + i) % 8; ++i)
+            data[i] = random_byte(offset + i);
+        for (; i + 8 <= size; i += 8) {
+            unsigned long long word = random_word(offset + i);
+            memcpy(data + i, &word, 8);
+        }
+        for (; i < size; ++i)
+            data[i] = random_byte(offset + i);
+    }
+    fill_offset += size;
+}
+
+long long Pattern::verify(const char *data, int size) {
+    long long offset = verify_offset;
+    verify_offset += size;
+    if (kind == DIGITS) {
+        const char *table = digits_table + offset % 10;
+        for (int i = 0; i < size; i += DIGITS_CHUNK) {
+            int n = size - i < DIGITS_CHUNK ? size - i : DIGITS_CHUNK;
+            int k = first_difference(data + i, table, n);
+            if (k >= 0) return offset + i + k;
+        }
+    } else {
+        int i = 0;
+        for (; i < size && (offset + i) % 8; ++i)
+            if (data[i] != random_byte(offset + i)) return offset + i;
+        for (; i + 8 <= size; i += 8) {
+            unsigned long long word = random_word(offset + i), got;
+            memcpy(&got, data + i, 8);
+            if (got != word) // the first differing byte, little-endian
+                return offset + i + __builtin_ctzll(got ^ word) / 8;
+        }
+        for (; i < size; ++i)
+            if (data[i] != random_byte(offset + i)) return offset + i;
+    }
+    return -1;
+}
+
+MessagePool::~MessagePool() {
+    for (size_t i = 0; i < free_list.size(); ++i) {
+        free(free_list[i]->msg.data);
+        delete free_list[i];
+    }
+}
+
+struct message *MessagePool::get(int size) {
+    Entry *entry;
+    if (free_list.empty()) {
+        entry = new Entry;
+        entry->msg.data = NULL;
+        entry->capacity = 0;
+    } else {
+        entry = free_list.back();
+        free_list.pop_back();
+    }
+    if (entry->capacity < size) {
+        free(entry->msg.data);
+        entry->msg.data = (char*) malloc(size);
+        ASSERT(entry->msg.data != NULL);
+        entry->capacity = size;
+    }
+    entry->msg.size = size;
+    return &entry->msg;
+}
+
+void MessagePool::put(struct message *msg) {
+    free_list.push_back(reinterpret_cast<Entry*>(msg));
+}
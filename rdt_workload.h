@@ -0,0 +1,147 @@
+/*
+ * FILE: rdt_workload.h
+ * DESCRIPTION: Workloads of the upper layer at the sender: when messages
+ *              arrive, how large they are, and the payload pattern that the
+ *              upper layer at the receiver verifies.
+ *
+ *       workloads: uniform                          (the original generator)
+ *                  bimodal:<small>,<large>,<p_large>
+ *                  pareto:<min_size>,<alpha>[,<max_size>]
+ *                  onoff:<on_mean>,<off_mean>
+ *                  trace:<file>                     (lines of "<time> <size>")
+ *       patterns:  digits                           ('0'..'9' repeating)
+ *                  random                           (pseudo-random bytes)
+ */
+
+
+#ifndef _RDT_WORKLOAD_H_
+#define _RDT_WORKLOAD_H_
+
+#include <stddef.h>
+#include <vector>
+#include "rdt_struct.h"
+
+/* generate a random number in [0,1], provided by the simulator */
+double myrandom();
+
+class Checkpoint;
+
+/* the original generator: sizes uniform in [0, 2*mean_size] and intervals
+   uniform in [0, 2*mean_interval].  the other workloads override the part
+   they shape */
+class Workload
+{
+public:
+    double mean_interval;
+    int mean_size;
+
+public:
+    Workload(double interval_, int size_) : mean_interval(interval_), mean_size(size_) {}
+    virtual ~Workload() {}
+    /* time of the first message */
+    virtual double first_arrival() { return 0; }
+    /* size of the message arriving now, called once per message */
+    virtual int size();
+    /* time until the next message, negative if there is none */
+    virtual double interval() { return mean_interval*2.0*myrandom(); }
+    /* save or restore the state the workload keeps between messages */
+    virtual void checkpoint(Checkpoint &ck) {}
+};
+
+/* a mix of small and large messages */
+class BimodalWorkload : public Workload
+{
+public:
+    int small, large;
+    double p_large;
+
+public:
+    BimodalWorkload(double interval_, int small_, int large_, double p_large_)
+        : Workload(interval_, 0), small(small_), large(large_), p_large(p_large_) {}
+    int size() { return myrandom() < p_large ? large : small; }
+};
+
+/* heavy-tailed message sizes, capped at max_size */
+class ParetoWorkload : public Workload
+{
+public:
+    int min_size, max_size;
+    double alpha;
+
+public:
+    ParetoWorkload(double interval_, int min_, double alpha_, int max_)
+        : Workload(interval_, 0), min_size(min_), max_size(max_), alpha(alpha_) {}
+    int size();
+};
+
+/* bursts of messages: exponentially distributed ON periods with the usual
+   arrivals, separated by exponentially distributed silent OFF periods */
+class OnOffWorkload : public Workload
+{
+public:
+    double on_mean, off_mean;
+    double clock, on_until;
+
+public:
+    OnOffWorkload(double interval_, int size_, double on_, double off_);
+    double interval();
+    void checkpoint(Checkpoint &ck);
+};
+
+/* replays recorded arrival times and sizes */
+class TraceWorkload : public Workload
+{
+public:
+    std::vector<double> times;
+    std::vector<int> sizes;
+    size_t cursor;
+
+public:
+    TraceWorkload() : Workload(0, 0), cursor(0) {}
+    bool load(const char *path);
+    double first_arrival() { return times[0]; }
+    int size() { return sizes[cursor]; }
+    double interval();
+    void checkpoint(Checkpoint &ck);
+};
+
+/* build a workload from its command line spec, return NULL if the spec is
+   invalid */
+Workload *make_workload(const char *spec, double mean_interval, int mean_size);
+
+/* the payload of the whole session is one byte stream; the sender fills it
+   and the receiver verifies it, each tracking its own offset */
+class Pattern
+{
+public:
+    enum Kind {DIGITS, RANDOM};
+    Kind kind;
+    long long fill_offset, verify_offset;
+
+public:
+    Pattern(Kind kind_) : kind(kind_), fill_offset(0), verify_offset(0) {}
+    void fill(char *data, int size);
+    /* check the next size bytes of the stream, return the stream offset of
+       the first byte that does not match, or -1 if they all do */
+    long long verify(const char *data, int size);
+};
+
+/* recycles message buffers so the generator does not malloc/free per
+   message */
+class MessagePool
+{
+private:
+    struct Entry {
+        struct message msg;
+        int capacity;
+    };
+    std::vector<Entry*> free_list;
+
+public:
+    ~MessagePool();
+    /* a message of the given size, with uninitialized data */
+    struct message *get(int size);
+    void put(struct message *msg);
+};
+
+#endif  /* _RDT_WORKLOAD_H_ */
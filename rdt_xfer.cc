@@ -0,0 +1,301 @@
+/*
+ * FILE: rdt_xfer.cc
+ * DESCRIPTION: Bulk file transfer over the rdt layer.  The input file is
+ *              mmap'd and handed to the sender a page at a time straight from
+ *              the mapping; the receiver writes what it delivers into an
+ *              output file mmap'd at the size of the input.  The transfer runs
+ *              over the simulated channel, or in real time over UDP on the
+ *              loopback interface.
+ *       usage: rdt_xfer [options] <input> <output>
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "rdt_struct.h"
+#include "rdt_sender.h"
+#include "rdt_util.h"
+#include "rdt_arq.h"
+#include "rdt_channel.h"
+#include "rdt_simcore.h"
+#include "rdt_profile.h"
+
+
+/* packets the sender may have queued before the next page is passed down,
+   keeps the send queue from holding a copy of the whole file */
+#define XFER_QUEUE 256
+
+/* how often the upper layer at the sender checks the send queue (in
+   seconds): the simulated link drains a queue of XFER_QUEUE packets in
+   seconds, the loopback one in milliseconds */
+#define XFER_POLL_SIMULATED 1.0
+#define XFER_POLL_REALTIME 0.0005
+
+
+/*[]------------------------------------------------------------------------[]
+  |  the transfer
+  []------------------------------------------------------------------------[]*/
+
+/* a 64-bit hash of the content, 8 bytes at a time */
+static unsigned long long content_hash(const char *data, size_t size)
+{
+    unsigned long long h = 0xcbf29ce484222325ULL ^ size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+	unsigned long long w;
+	memcpy(&w, data + i, 8);
+	h = (h ^ w) * 0x100000001b3ULL;
+	h ^= h >> 29;
+    }
+    for (; i < size; i++)
+	h = (h ^ (unsigned char) data[i]) * 0x100000001b3ULL;
+    return h ^ (h >> 32);
+}
+
+class FileTransfer : public Application
+{
+public:
+    const char *in_data;
+    char *out_data;
+    size_t size, page;
+    size_t sent, delivered;
+    long long overflow;     /* bytes delivered beyond the end of the file */
+
+public:
+    FileTransfer(const char *in_, char *out_, size_t size_)
+	: in_data(in_), out_data(out_), size(size_), sent(0), delivered(0), overflow(0) {
+	page = sysconf(_SC_PAGESIZE);
+    }
+
+    double first_arrival() { return size > 0 ? 0 : -1; }
+
+    /* pass pages down until the send queue is long enough */
+    double send_next() {
+	while (sent < size && sender_stats.queue_depth < XFER_QUEUE) {
+	    struct message msg;
+	    msg.size = size - sent < page ? size - sent : page;
+	    msg.data = (char*) in_data + sent;
+	    Sender_FromUpperLayer(&msg);
+	    sent += msg.size;
+	}
+	if (sent == size) return -1;
+	return realtime_mode ? XFER_POLL_REALTIME : XFER_POLL_SIMULATED;
+    }
+
+    /* the rdt layer delivers in order, so the data goes at the end of what
+       has been delivered */
+    void deliver(struct message *msg, int stream) {
+	if (delivered + msg->size > size) {
+	    overflow += msg->size;
+	    return;
+	}
+	memcpy(out_data + delivered, msg->data, msg->size);
+	delivered += msg->size;
+    }
+};
+
+
+/*[]------------------------------------------------------------------------[]
+  |  main routine
+  []------------------------------------------------------------------------[]*/
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [options] <input> <output>\n"
+	    "options:\n"
+	    "\t--loopback         run in real time over UDP on the loopback interface\n"
+	    "\t--batch            print key=value metrics\n"
+	    "\t--seed=N           seed the random number generator with N\n"
+	    "\t--loss=SPEC        loss model of both directions, as in rdt_sim (default none)\n"
+	    "\t--delay=SPEC       delay model of both directions, as in rdt_sim (default constant:0.1),\n"
+	    "\t                   ignored with --loopback\n"
+	    "\t--corrupt=P        corrupt packets with probability P\n"
+	    "\t--parallel         run the sender and the receiver sides on their own threads\n"
+	    "\t--batch-dispatch   hand packets arriving at the same time to the rdt layer together\n"
+	    "\t--nak              the receiver reports gaps with NAKs\n"
+	    "\t--compress         compress the payload of pages that shrink\n"
+	    "\t--arq=KIND         ARQ strategy, sr (default), gbn or saw as in rdt_sim\n"
+	    "\t--profile          print the cycles, instructions and cache misses by region\n",
+	    prog);
+    exit(-1);
+}
+
+int main(int argc, char *argv[])
+{
+    static struct option long_options[] = {
+	{"loopback", no_argument, NULL, 'r'},
+	{"batch", no_argument, NULL, 'b'},
+	{"seed", required_argument, NULL, 's'},
+	{"loss", required_argument, NULL, 'l'},
+	{"delay", required_argument, NULL, 'd'},
+	{"corrupt", required_argument, NULL, 'c'},
+	{"parallel", no_argument, NULL, 'P'},
+	{"batch-dispatch", no_argument, NULL, 'B'},
+	{"nak", no_argument, NULL, 'n'},
+	{"compress", no_argument, NULL, 'z'},
+	{"arq", required_argument, NULL, 'a'},
+	{"profile", no_argument, NULL, 'f'},
+	{NULL, 0, NULL, 0}
+    };
+
+    const char *loss_spec = "bernoulli:0", *delay_spec = "constant:0.1";
+    unsigned int seed = getpid();
+    bool batch_mode = false;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", long_options, NULL)) != -1) {
+	switch (opt) {
+	case 'r':
+	    realtime_mode = true;
+	    break;
+	case 'b':
+	    batch_mode = true;
+	    break;
+	case 's':
+	    seed = strtoul(optarg, NULL, 0);
+	    break;
+	case 'l':
+	    loss_spec = optarg;
+	    break;
+	case 'd':
+	    delay_spec = optarg;
+	    break;
+	case 'c':
+	    corrupt_rate = atof(optarg);
+	    if (!is_prob(corrupt_rate)) usage(argv[0]);
+	    break;
+	case 'P':
+	    parallel_mode = true;
+	    break;
+	case 'B':
+	    batch_dispatch = true;
+	    break;
+	case 'n':
+	    rdt_config.nak = true;
+	    break;
+	case 'z':
+	    rdt_config.compress = true;
+	    break;
+	case 'a':
+	    rdt_config.arq = parse_arq(optarg);
+	    if (rdt_config.arq<0) usage(argv[0]);
+	    break;
+	case 'f':
+	    profiling = true;
+	    break;
+	default:
+	    usage(argv[0]);
+	}
+    }
+    if (argc-optind!=2) usage(argv[0]);
+    if (rdt_config.arq!=ARQ_SR && (rdt_config.nak || rdt_config.compress)) usage(argv[0]);
+    const char *in_path = argv[optind], *out_path = argv[optind+1];
+
+    /* the input, mapped read-only */
+    int in_fd = open(in_path, O_RDONLY);
+    struct stat st;
+    if (in_fd<0 || fstat(in_fd, &st)<0) {
+	perror(in_path);
+	exit(-1);
+    }
+    size_t size = st.st_size;
+    const char *in_data = NULL;
+    if (size > 0) {
+	in_data = (const char*) mmap(NULL, size, PROT_READ, MAP_PRIVATE, in_fd, 0);
+	if (in_data==MAP_FAILED) {
+	    perror("mmap input");
+	    exit(-1);
+	}
+	madvise((void*) in_data, size, MADV_SEQUENTIAL);
+    }
+
+    /* the output, preallocated to the size of the input and mapped shared
+       so the delivered data lands in the file */
+    int out_fd = open(out_path, O_RDWR|O_CREAT|O_TRUNC, 0644);
+    if (out_fd<0 || ftruncate(out_fd, size)<0) {
+	perror(out_path);
+	exit(-1);
+    }
+    char *out_data = NULL;
+    if (size > 0) {
+	out_data = (char*) mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, out_fd, 0);
+	if (out_data==MAP_FAILED) {
+	    perror("mmap output");
+	    exit(-1);
+	}
+	madvise(out_data, size, MADV_SEQUENTIAL);
+    }
+
+    sim_init(seed);
+    s2r_channel.loss = make_loss_model(loss_spec);
+    r2s_channel.loss = make_loss_model(loss_spec);
+    s2r_channel.delay = make_delay_model(delay_spec);
+    r2s_channel.delay = make_delay_model(delay_spec);
+    if (s2r_channel.loss==NULL || r2s_channel.loss==NULL ||
+	s2r_channel.delay==NULL || r2s_channel.delay==NULL) {
+	fprintf(stderr, "invalid loss or delay model\n");
+	exit(-1);
+    }
+    if (!sim_prepare()) exit(-1);
+
+    fprintf(stdout, "## Transferring %s (%zu bytes) to %s over the %s\n", in_path, size, out_path,
+	    realtime_mode ? "loopback interface" : "simulated channel");
+
+    FileTransfer transfer(in_data, out_data, size);
+    sim_run(&transfer);
+
+    unsigned long long in_hash = content_hash(in_data, size);
+    unsigned long long out_hash = content_hash(out_data, transfer.delivered);
+    bool verified = transfer.delivered==size && transfer.overflow==0 && in_hash==out_hash;
+    double throughput = wall_seconds>0 ? transfer.delivered/wall_seconds : 0.0;
+
+    fprintf(stdout, "\n## Transfer completed at time %.2fs with\n"
+	    "\t%zu of %zu bytes delivered in %.3f seconds (%.2f MB/s)\n"
+	    "\tcontent hash %016llx, input %016llx\n",
+	    sim_end_time(), transfer.delivered, size, wall_seconds, throughput/1e6,
+	    out_hash, in_hash);
+    if (verified)
+	fprintf(stdout, "## The output is identical to the input.\n");
+    else
+	fprintf(stdout, "## Something is wrong! The output differs from the input.\n");
+    if (profiling) print_profile();
+
+    if (batch_mode) {
+	fprintf(stdout, "## Metrics\n"
+		"xfer.bytes=%zu\n"
+		"xfer.delivered=%zu\n"
+		"xfer.verified=%d\n"
+		"xfer.hash=%016llx\n"
+		"xfer.sim_time=%.6f\n"
+		"xfer.wall_seconds=%.6f\n"
+		"xfer.bytes_per_sec=%.0f\n"
+		"xfer.events=%lld\n"
+		"xfer.pkts_passed=%d\n"
+		"xfer.batches=%lld\n"
+		"xfer.mean_batch=%.3f\n",
+		size, transfer.delivered, verified ? 1 : 0, out_hash, sim_end_time(),
+		wall_seconds, throughput, tot_events, tot_pkts_passed,
+		tot_batches, tot_batches>0 ? (double) tot_batched/tot_batches : 0.0);
+	print_protocol_metrics();
+    }
+
+    if (size > 0) {
+	munmap((void*) in_data, size);
+	munmap(out_data, size);
+    }
+    close(in_fd);
+    close(out_fd);
+    delete s2r_channel.loss;
+    delete s2r_channel.delay;
+    delete r2s_channel.loss;
+    delete r2s_channel.delay;
+
+    return verified ? 0 : 1;
+}